@@ -43,9 +43,10 @@ void parent(int pfd[2])
   close(pfd[WRITE]);
   // read from pipe
   char filename[1000], large_filename[1000];
-  int size, large_size = 0, fcnt = 0, fsize = 0;
+  long long size, large_size = 0, fsize = 0;
+  int fcnt = 0;
   FILE *fp1 = fdopen(pfd[READ], "r");
-  while (fscanf(fp1, "%d %s", &size, filename) != -1) {
+  while (fscanf(fp1, "%lld %s", &size, filename) != -1) {
     if (size > large_size) {
       large_size = size;
       strcpy(large_filename, filename);
@@ -55,8 +56,8 @@ void parent(int pfd[2])
   }
   
   FILE *fp2 = fdopen(STDOUT_FILENO, "w");
-  fprintf(fp2, "Found %d files with a total size of %d bytes.\n", fcnt, fsize);
-  fprintf(fp2, "The largest file is '%s' with a size of %d bytes.\n", large_filename, large_size);
+  fprintf(fp2, "Found %d files with a total size of %lld bytes.\n", fcnt, fsize);
+  fprintf(fp2, "The largest file is '%s' with a size of %lld bytes.\n", large_filename, large_size);
   
   fclose(fp1);
   fclose(fp2);
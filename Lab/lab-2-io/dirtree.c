@@ -13,20 +13,48 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/syscall.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <errno.h>
 #include <unistd.h>
 #include <stdarg.h>
 #include <assert.h>
 #include <grp.h>
 #include <pwd.h>
+#include <pthread.h>
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/sysmacros.h>
+#define HAVE_IO_URING 1
+#endif
 
-#define MAX_DIR 64            ///< maximum number of directories supported
+#define MAX_THREADS 256       ///< maximum number of worker threads (-j)
+#define DENTS_BUFSIZE 65536   ///< minimum free space in the buffer passed to getdents64
+#define STDOUT_BUFSIZE (1<<20) ///< stdout buffer size if not writing to a terminal
+#define RECORD_FLUSH 65536    ///< flush a worker's records to stdout beyond this size
+#define CACHE_MAGIC 0x43545244 ///< summary cache file magic ("DRTC")
+#define CACHE_VERSION 2       ///< summary cache file version
+#define URING_ENTRIES 256     ///< io_uring submission queue size (statx batch size)
+#define LINKSET_BITS 6        ///< log2 of the number of shards of a hardlink set
+#define HIST_BUCKETS 65       ///< log2 size histogram buckets: 0, [1,2), [2,4), ..., [2^63,2^64)
 
 /// @brief output control flags
 #define F_TREE      0x1       ///< enable tree view
 #define F_SUMMARY   0x2       ///< enable summary
 #define F_VERBOSE   0x4       ///< turn on verbose mode
+#define F_JSON      0x8       ///< machine-readable output: JSON lines
+#define F_CSV       0x10      ///< machine-readable output: CSV
+#define F_RECORDS   (F_JSON | F_CSV)
+#define F_CACHE     0x20      ///< summaries only, using the summary cache
+#define F_URING     0x40      ///< stat entries in batches with io_uring
+#define F_XDEV      0x80      ///< do not descend into directories on other file systems
+#define F_DEDUP     0x100     ///< count the size of hardlinked files only once
+#define F_TOPK      0x200     ///< rank the largest files and build a size histogram
+#define F_UNSORTED  0x400     ///< list entries in directory order, one chunk at a time
 
 /// @brief struct holding the summary
 struct summary {
@@ -41,179 +69,1889 @@ struct summary {
 };
 
 
+//
+// Parallel traversal
+// ==================
+// Every directory is a task (struct dnode). Processing a directory renders its entries into the
+// node's output buffer and creates one child node per subdirectory. The position in the output
+// where the subdirectory's listing belongs is recorded as a splice point.
+//
+// With -j N, N worker threads process the nodes. Each worker owns a deque of nodes: it pushes
+// and pops the subdirectories it discovers at the bottom (depth-first, good locality) while idle
+// workers steal from the top of other workers' deques (large subtrees close to the root).
+// The main thread emits the output: it walks the node tree in order and waits for nodes that
+// have not been processed yet. The output is therefore identical to the sequential traversal.
+//
+// Each worker accumulates the statistics of the entries it processes in its own summary, which
+// is merged into the summary of the directory's root after each directory. Several roots can
+// thus be traversed concurrently: the main thread keeps up to 4*N roots in flight and emits
+// their output (and summaries) in the order of the arguments.
+//
+// Directories are opened with openat() relative to the parent directory's descriptor and the
+// entries are stat'ed with fstatat(), so the kernel resolves a single path component per entry
+// instead of the whole path. A directory's descriptor is reference-counted: it stays open until
+// the directory itself and all its subdirectories have been opened.
+//
+// Entries are rendered straight into the output buffer without temporary strings. The prefix of
+// a directory's entries consists of one two-character indent per ancestor ("| " or "  " in tree
+// view); each node only stores whether it is the last entry of its parent and the worker rebuilds
+// the prefix in its reusable, depth-indexed prefix buffer once per directory.
+//
+// With -o json/csv, one record per entry is written instead. Records are not spliced into the
+// tree: each worker collects them in a small buffer that is written to stdout whenever it fills
+// up, so memory stays constant. The records of a parallel traversal are thus not in tree order.
+//
+// Summary cache
+// -------------
+// With -c <file>, only the summaries are printed and a per-directory cache is kept in <file>.
+// A cache record holds a directory's identity (device, inode), its mtime and ctime, the summary
+// of the directory's own entries (not recursive; subdirectories account for their own size),
+// the names of its subdirectories, and the names, inodes, sizes, mtimes and ctimes of its other
+// entries. A directory is still opened and fstat'ed, but if its record matches, its entries are
+// not read and only the recorded files are stat'ed: the cached summary is used and only the
+// cached subdirectories are visited (and validated the same way). Invalidation rules:
+// - a directory without a record (new directory or new inode) is scanned
+// - a directory whose mtime or ctime differ is scanned. Creating, deleting or renaming an entry
+//   updates the mtime, changing the directory's owner or permissions updates the ctime
+// - a directory with a file whose inode, size, mtime or ctime differ is scanned. Modifying a
+//   file in place does not update the times of its directory, but those of the file
+// - the subdirectories of a directory are validated individually, whether it is cached or not
+// - the cache file is rewritten after each run with the records of all visited directories;
+//   stale records are dropped. Cache files with a wrong magic or version or with a malformed
+//   record are ignored as a whole
+//
+// Batched stat
+// ------------
+// The entries of a directory are stat'ed in one go before they are rendered. By default, this
+// is a loop of fstatat() calls. With -u, each worker sets up an io_uring and submits one
+// IORING_OP_STATX request per entry, up to URING_ENTRIES at a time, with a single
+// io_uring_enter() call; the kernel can then work on all of them concurrently. If io_uring
+// is not available (old kernel, disabled by sysctl or seccomp), dirtree falls back to fstatat().
+//
+// Disk usage
+// ----------
+// With -x, every directory is fstat'ed after it has been opened; directories on a different
+// device than their root (mount points) are listed but not traversed. With -d, the size and
+// blocks of a file with more than one link are only counted for the first link encountered,
+// as du does. The (device, inode) pairs seen are kept in one set per device; each set consists
+// of 2^LINKSET_BITS independently locked open-addressing tables of bare 64-bit inode numbers,
+// so that workers rarely contend and an entry costs 8 bytes (at most 16 with the load factor
+// of 3/4). Only files with st_nlink > 1 are inserted. Entry counts are not deduplicated, and
+// with -d roots are traversed one after the other so that a file linked from several roots
+// is always accounted to the first one.
+//
+// Sorting
+// -------
+// Entries are sorted with a radix sort on a key array instead of qsort() on the entries: each
+// key holds the first 8 bytes of the name as a big-endian integer next to the entry pointer.
+// Directories are partitioned to the front first, then both partitions are LSD radix sorted on
+// the key (passes in which all keys share the same byte are skipped). Only runs of names with
+// a common 8-byte prefix are compared with strcmp(). The result is the same as before.
+//
+// With -U, entries are not sorted but processed in directory order, one getdents64() chunk at
+// a time: the entry, stat and key arrays stay bounded by the chunk size instead of growing with
+// the directory. The last entry of a chunk is held back until the next chunk has been read, so
+// that the tree connector of the directory's last entry is known. In a sequential traversal,
+// all output before the directory being processed has already been emitted; its listing is
+// therefore written to stdout after each chunk as long as no subdirectory has to be spliced in.
+// Maildir-style directories with millions of files are thus streamed with constant memory.
+//
+// Largest files
+// -------------
+// With -k N, the entries are not listed. Instead, each worker keeps the N largest regular files
+// it has seen in a min-heap ordered by (size, path) and counts all files in a log2 size
+// histogram. The heap's root is the smallest of the N files, so a file that is not larger is
+// rejected with one comparison and without building its path. After the traversal, the heaps
+// and histograms of the workers are merged; ties are broken by path so the result does not
+// depend on the number of threads. Memory is O(N) per worker.
+//
+
+/// @brief growable output buffer
+struct obuf {
+  char *buf;                  ///< buffer
+  size_t len;                 ///< number of bytes in buffer
+  size_t cap;                 ///< capacity of buffer
+};
+
+/// @brief position in a directory's output where a subdirectory's output is inserted
+struct splice {
+  size_t pos;                 ///< offset into the parent's output buffer
+  struct dnode *child;        ///< subdirectory
+};
+
+/// @brief a root directory (path given on the command line)
+struct root {
+  const char *path;           ///< path of the root
+  struct dnode *node;         ///< directory node of the root
+  dev_t dev;                  ///< device of the root directory (-x)
+  pthread_mutex_t lock;       ///< protects @a stats
+  struct summary stats;       ///< statistics of the tree
+};
+
+/// @brief a directory to be processed
+struct dnode {
+  struct root *root;          ///< root of the tree the directory belongs to
+  char *name;                 ///< name of the directory relative to @a parent (path for roots)
+  struct dnode *parent;       ///< parent directory or NULL for roots
+  int fd;                     ///< directory descriptor
+  int refcnt;                 ///< references to @a fd (the node + unopened subdirectories)
+  unsigned int depth;         ///< depth below the root (0: root)
+  int last;                   ///< set if the directory is the last entry of its parent
+  struct obuf out;            ///< rendered entries
+  struct splice *sp;          ///< splice points of the subdirectories, in output order
+  unsigned int nsp;           ///< number of splice points
+  int done;                   ///< set once the directory has been processed
+};
+
+/// @brief work-stealing deque of directory nodes
+struct deque {
+  pthread_mutex_t lock;       ///< protects the deque
+  struct dnode **node;        ///< nodes
+  size_t top;                 ///< index of the oldest node (stolen by other workers)
+  size_t bottom;              ///< index past the newest node (pushed/popped by the owner)
+  size_t cap;                 ///< capacity of node array
+};
+
+/// @brief sort key of a directory entry
+struct skey {
+  uint64_t pfx;               ///< first 8 bytes of the name, big-endian, zero-padded
+  struct dirent64 *e;         ///< entry
+};
+
+/// @brief a ranked file (-k)
+struct tkent {
+  unsigned long long size;    ///< file size
+  char *path;                 ///< path of the file
+};
+
+/// @brief worker state
+struct worker {
+  pthread_t thread;           ///< worker thread
+  unsigned int id;            ///< worker index
+  struct deque dq;            ///< nodes to be processed
+  struct summary stats;       ///< statistics of the directory being processed
+
+  struct obuf pfx;            ///< prefix of the entries of the directory being processed
+  struct obuf path;           ///< path of the directory being processed (-o)
+  struct obuf rec;            ///< records not yet written to stdout (-o)
+  struct obuf cache;          ///< cache records of the processed directories (-c)
+  struct obuf cfile;          ///< cfile records of the directory being processed (-c)
+  struct obuf cname;          ///< names of the entries in @a cfile (-c)
+  struct tkent *topk;         ///< min-heap of the largest files seen (-k)
+  unsigned int ntopk;         ///< number of files in @a topk
+  unsigned long long hcount[HIST_BUCKETS]; ///< number of files per size bucket (-k)
+  unsigned long long hbytes[HIST_BUCKETS]; ///< total size of the files per size bucket (-k)
+  struct obuf fpath;          ///< path of a file entering @a topk
+  struct stat *st;            ///< stat of the entries of the directory being processed
+  size_t stcap;               ///< capacity of @a st
+#ifdef HAVE_IO_URING
+  struct uring *ring;         ///< io_uring (-u), NULL if not set up yet
+  struct statx *stx;          ///< statx buffers of the current batch
+#endif
+  struct obuf dents;          ///< raw entries of the directory being processed
+  struct dirent64 **ent;      ///< pointers to the entries in @a dents
+  size_t entcap;              ///< capacity of @a ent
+  struct skey *key;           ///< sort keys of the entries and scratch space for the radix sort
+  size_t keycap;              ///< capacity of @a key (scratch space not counted)
+};
+
+/// @brief cache mapping user or group ids to names
+struct namecache {
+  pthread_rwlock_t lock;      ///< protects the cache
+  int group;                  ///< 0: user ids, 1: group ids
+  struct {
+    unsigned int id;          ///< user/group id
+    char *name;               ///< name (NULL: empty slot)
+  } *slot;                    ///< open-addressing hash table
+  size_t cap;                 ///< number of slots (power of two)
+  size_t n;                   ///< number of used slots
+};
+
+/// @brief cache file header
+struct chdr {
+  uint32_t magic;             ///< CACHE_MAGIC
+  uint32_t version;           ///< CACHE_VERSION
+  uint64_t nrec;              ///< number of records
+};
+
+/// @brief cache record of a directory, followed by the stats of its other entries (nfile
+///        struct cfile), the NUL-terminated names of its subdirectories and then those of its
+///        other entries (padded to a multiple of 8 bytes)
+struct crec {
+  uint64_t dev;               ///< device of the directory
+  uint64_t ino;               ///< inode of the directory
+  int64_t  mtime[2];          ///< modification time (seconds, nanoseconds)
+  int64_t  ctime[2];          ///< status change time (seconds, nanoseconds)
+  struct summary own;         ///< statistics of the directory's entries (not recursive)
+  uint32_t nsub;              ///< number of subdirectories
+  uint32_t nfile;             ///< number of other entries (files, links, pipes, ...)
+  uint32_t len;               ///< size of the data following the record
+  uint32_t pad;               ///< unused (0)
+};
+
+/// @brief cache record of an entry other than a directory
+struct cfile {
+  uint64_t ino;               ///< inode
+  int64_t  size;              ///< size
+  int64_t  mtime[2];          ///< modification time (seconds, nanoseconds)
+  int64_t  ctime[2];          ///< status change time (seconds, nanoseconds)
+};
+
+#ifdef HAVE_IO_URING
+/// @brief io_uring submission and completion queues (mapped from the kernel)
+struct uring {
+  int fd;                     ///< io_uring file descriptor
+  unsigned int *sq_tail;      ///< submission queue tail
+  unsigned int *sq_mask;      ///< submission queue index mask
+  unsigned int *sq_array;     ///< submission queue index array
+  struct io_uring_sqe *sqes;  ///< submission queue entries
+  unsigned int *cq_head;      ///< completion queue head
+  unsigned int *cq_tail;      ///< completion queue tail
+  unsigned int *cq_mask;      ///< completion queue index mask
+  struct io_uring_cqe *cqes;  ///< completion queue entries
+};
+#endif
+
+/// @brief one shard of a hardlink set: open-addressing table of inode numbers
+struct lshard {
+  pthread_mutex_t lock;       ///< protects the shard
+  uint64_t *ino;              ///< inode numbers (0: empty slot)
+  size_t cap;                 ///< number of slots (power of 2)
+  size_t n;                   ///< number of inode numbers in the table
+};
+
+/// @brief inodes of the hardlinked files seen on one device
+struct linkset {
+  struct linkset *next;       ///< set of the next device
+  dev_t dev;                  ///< device
+  int zero;                   ///< set if inode 0 has been seen
+  struct lshard shard[1 << LINKSET_BITS];
+};
+
+/// @brief emitter cursor into the output of a directory node
+struct cursor {
+  struct dnode *node;         ///< directory node
+  unsigned int sp;            ///< next splice point
+  size_t pos;                 ///< output emitted so far
+};
+
+static unsigned int oflags;                                  ///< output control flags
+static struct worker *workers;                               ///< workers
+static unsigned int nworkers = 1;                            ///< number of workers
+static int parallel;                                         ///< set if worker threads run
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER; ///< protects idle workers
+static pthread_cond_t  pool_cv   = PTHREAD_COND_INITIALIZER;  ///< signals new work/shutdown
+static unsigned long   pool_gen;                             ///< incremented on every push
+static unsigned int    pool_idle;                            ///< number of idle workers
+static int             pool_shutdown;                        ///< terminate worker threads
+
+static pthread_mutex_t done_lock = PTHREAD_MUTEX_INITIALIZER; ///< protects dnode.done
+static pthread_cond_t  done_cv   = PTHREAD_COND_INITIALIZER;  ///< signals a processed node
+static struct dnode   *waiting;                              ///< node the emitter waits for
+
+static struct namecache users  = { PTHREAD_RWLOCK_INITIALIZER, 0 }; ///< user names
+static struct namecache groups = { PTHREAD_RWLOCK_INITIALIZER, 1 }; ///< group names
+
+static pthread_mutex_t out_lock = PTHREAD_MUTEX_INITIALIZER; ///< serializes record output
+
+static int uring_failed;                                     ///< set if io_uring is unavailable (atomic)
+
+static char *cache;                                          ///< loaded cache file
+static const struct crec **ctab;                             ///< cache records by (dev, ino)
+static size_t ctab_size;                                     ///< number of slots in ctab
+
+static unsigned int topk;                                    ///< number of files to rank (-k)
+
+static struct linkset *linksets;                             ///< hardlink sets, one per device
+static pthread_mutex_t linksets_lock = PTHREAD_MUTEX_INITIALIZER; ///< serializes new devices
+
+static struct cursor *estack;                                ///< emitter cursor stack
+static unsigned int edepth, ecap;                            ///< depth/capacity of estack
+
+
 /// @brief abort the program with EXIT_FAILURE and an optional error message
 ///
-/// @param msg optional error message or NULL
-void panic(const char *msg)
+/// @param msg optional error message or NULL
+void panic(const char *msg)
+{
+  if (msg) fprintf(stderr, "%s\n", msg);
+  exit(EXIT_FAILURE);
+}
+
+
+/// @brief make room for at least @a n more bytes in output buffer @a ob
+static void ob_reserve(struct obuf *ob, size_t n)
+{
+  if (ob->len + n > ob->cap) {
+    size_t cap = ob->cap ? 2*ob->cap : 256;
+    while (cap < ob->len + n) cap *= 2;
+    if ((ob->buf = realloc(ob->buf, cap)) == NULL) panic("OUT OF MEMORY!");
+    ob->cap = cap;
+  }
+}
+
+
+/// @brief append @a n bytes from @a s to output buffer @a ob
+static void ob_write(struct obuf *ob, const char *s, size_t n)
+{
+  if (n == 0) return;
+  ob_reserve(ob, n);
+  memcpy(ob->buf + ob->len, s, n);
+  ob->len += n;
+}
+
+
+/// @brief append formatted output to output buffer @a ob
+///
+/// @param ob output buffer
+/// @param fmt printf format string
+/// @param ... parameters to the format string
+static void ob_printf(struct obuf *ob, const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start(ap, fmt);
+  int n = vsnprintf(ob->buf ? ob->buf + ob->len : NULL, ob->cap - ob->len, fmt, ap);
+  va_end(ap);
+  if (n < 0) panic("OUTPUT ERROR!");
+
+  if (ob->len + n + 1 > ob->cap) {
+    ob_reserve(ob, n + 1);
+
+    va_start(ap, fmt);
+    vsnprintf(ob->buf + ob->len, ob->cap - ob->len, fmt, ap);
+    va_end(ap);
+  }
+
+  ob->len += n;
+}
+
+
+/// @brief look up id @a id in cache @a nc
+///
+/// @retval char* name
+/// @retval NULL if not cached
+static const char* nc_find(struct namecache *nc, unsigned int id)
+{
+  if (nc->cap == 0) return NULL;
+
+  for (size_t i = (id * 2654435761u) & (nc->cap - 1); nc->slot[i].name; i = (i + 1) & (nc->cap - 1)) {
+    if (nc->slot[i].id == id) return nc->slot[i].name;
+  }
+  return NULL;
+}
+
+
+/// @brief map user (or group) id @a id to its name. Names are resolved once with the reentrant
+///        getpwuid_r/getgrgid_r and then served from the cache. Unknown ids map to the number.
+///        Thread-safe.
+///
+/// @param nc user or group name cache
+/// @param id user or group id
+/// @retval char* name (valid until the program terminates)
+static const char* idName(struct namecache *nc, unsigned int id)
+{
+  pthread_rwlock_rdlock(&nc->lock);
+  const char *name = nc_find(nc, id);
+  pthread_rwlock_unlock(&nc->lock);
+  if (name) return name;
+
+  // not cached: resolve the id
+  char *buf = NULL, *res = NULL;
+  size_t bufsize = 1024;
+  int error;
+  do {
+    if ((buf = realloc(buf, bufsize)) == NULL) panic("OUT OF MEMORY!");
+    if (nc->group) {
+      struct group gr, *r;
+      error = getgrgid_r(id, &gr, buf, bufsize, &r);
+      if ((error == 0) && r) res = strdup(gr.gr_name);
+    } else {
+      struct passwd pw, *r;
+      error = getpwuid_r(id, &pw, buf, bufsize, &r);
+      if ((error == 0) && r) res = strdup(pw.pw_name);
+    }
+    bufsize *= 2;
+  } while (error == ERANGE);
+  free(buf);
+
+  if ((res == NULL) && (asprintf(&res, "%u", id) == -1)) panic("OUT OF MEMORY!");
+
+  // insert unless another thread was faster; keep the table at most half full
+  pthread_rwlock_wrlock(&nc->lock);
+  if ((name = nc_find(nc, id)) != NULL) {
+    free(res);
+  } else {
+    if (2*(nc->n + 1) > nc->cap) {
+      size_t cap = nc->cap ? 2*nc->cap : 64;
+      void *slot = calloc(cap, sizeof(nc->slot[0]));
+      if (slot == NULL) panic("OUT OF MEMORY!");
+
+      struct namecache old = *nc;
+      nc->slot = slot;
+      nc->cap = cap;
+      for (size_t i = 0; i < old.cap; i++) {
+        if (old.slot[i].name == NULL) continue;
+        size_t j = (old.slot[i].id * 2654435761u) & (cap - 1);
+        while (nc->slot[j].name) j = (j + 1) & (cap - 1);
+        nc->slot[j] = old.slot[i];
+      }
+      free(old.slot);
+    }
+
+    size_t i = (id * 2654435761u) & (nc->cap - 1);
+    while (nc->slot[i].name) i = (i + 1) & (nc->cap - 1);
+    nc->slot[i].id = id;
+    nc->slot[i].name = res;
+    nc->n++;
+    name = res;
+  }
+  pthread_rwlock_unlock(&nc->lock);
+
+  return name;
+}
+
+
+/// @brief append @a n bytes from @a s to output buffer @a ob as the contents of a JSON string
+///        or a CSV field (depending on the output control flags @a flags)
+static void ob_quote(struct obuf *ob, const char *s, size_t n, unsigned int flags)
+{
+  ob_reserve(ob, 6*n + 2);
+  char *d = ob->buf + ob->len;
+
+  *d++ = '"';
+  for (size_t i = 0; i < n; i++) {
+    unsigned char c = s[i];
+    if (flags & F_CSV) {
+      if (c == '"') *d++ = '"';
+      *d++ = c;
+    } else if ((c == '"') || (c == '\\')) {
+      *d++ = '\\';
+      *d++ = c;
+    } else if (c < 0x20) {
+      d += sprintf(d, "\\u%04x", c);
+    } else {
+      *d++ = c;
+    }
+  }
+  *d++ = '"';
+
+  ob->len = d - ob->buf;
+}
+
+
+/// @brief write the records collected by worker @a w to stdout
+static void recFlush(struct worker *w)
+{
+  if (w->rec.len == 0) return;
+
+  pthread_mutex_lock(&out_lock);
+  fwrite(w->rec.buf, 1, w->rec.len, stdout);
+  pthread_mutex_unlock(&out_lock);
+  w->rec.len = 0;
+}
+
+
+/// @brief append the record of entry @a name to worker @a w's records. The path of the
+///        directory containing the entry is in w->path.
+///
+/// @param w worker
+/// @param name name of the entry
+/// @param type type character of the entry (as printed in verbose mode)
+/// @param st stat of the entry
+static void recEntry(struct worker *w, const char *name, unsigned char type, struct stat *st)
+{
+  const char *tname = (type == ' ') ? "file"     :
+                      (type == 'd') ? "dir"      :
+                      (type == 'l') ? "link"     :
+                      (type == 'c') ? "chardev"  :
+                      (type == 'b') ? "blockdev" :
+                      (type == 'f') ? "fifo"     :
+                      (type == 's') ? "socket"   : "unknown";
+
+  // path = <directory>/<name>
+  size_t dlen = w->path.len;
+  ob_write(&w->path, "/", 1);
+  ob_write(&w->path, name, strlen(name));
+
+  if (oflags & F_JSON) {
+    ob_write(&w->rec, "{\"path\":", 8);
+    ob_quote(&w->rec, w->path.buf, w->path.len, oflags);
+    ob_printf(&w->rec, ",\"type\":\"%s\",\"size\":%lld,\"blocks\":%lld,\"uid\":%u,\"gid\":%u}\n",
+              tname, (long long)st->st_size, (long long)st->st_blocks, st->st_uid, st->st_gid);
+  } else {
+    ob_quote(&w->rec, w->path.buf, w->path.len, oflags);
+    ob_printf(&w->rec, ",%s,%lld,%lld,%u,%u,,,,,\n",
+              tname, (long long)st->st_size, (long long)st->st_blocks, st->st_uid, st->st_gid);
+  }
+
+  w->path.len = dlen;
+  if (w->rec.len > RECORD_FLUSH) recFlush(w);
+}
+
+
+/// @brief hash slot of directory (@a dev, @a ino) in the cache table
+static size_t cacheHash(uint64_t dev, uint64_t ino)
+{
+  return ((ino * 0x9e3779b97f4a7c15ull) ^ dev) & (ctab_size - 1);
+}
+
+
+/// @brief check that cache record @a r is well-formed and fits into the @a avail bytes left in
+///        the cache file
+///
+/// @retval 1 if the record is valid
+/// @retval 0 otherwise
+static int cacheCheck(const struct crec *r, size_t avail)
+{
+  if ((avail < sizeof(struct crec)) || (r->len > avail - sizeof(struct crec)) || (r->len % 8 != 0) ||
+      (r->nfile > r->len / sizeof(struct cfile))) {
+    return 0;
+  }
+
+  // all names must be NUL-terminated within the record and be plain entry names
+  const char *name = (const char*)((const struct cfile*)(r + 1) + r->nfile);
+  const char *end  = (const char*)(r + 1) + r->len;
+  for (uint64_t i = 0; i < (uint64_t)r->nsub + r->nfile; i++) {
+    const char *nul = memchr(name, '\0', end - name);
+    if ((nul == NULL) || (nul == name) || memchr(name, '/', nul - name) ||
+        (strcmp(name, ".") == 0) || (strcmp(name, "..") == 0)) {
+      return 0;
+    }
+    name = nul + 1;
+  }
+  return 1;
+}
+
+
+/// @brief load the summary cache from file @a fn. A missing or invalid file yields an empty cache.
+static void cacheLoad(const char *fn)
+{
+  FILE *f = fopen(fn, "r");
+  if (f == NULL) return;
+
+  struct stat st;
+  struct chdr *hdr;
+  if ((fstat(fileno(f), &st) != 0) || (st.st_size < (off_t)sizeof(struct chdr)) ||
+      ((cache = malloc(st.st_size)) == NULL) || (fread(cache, 1, st.st_size, f) != (size_t)st.st_size)) {
+    fclose(f);
+    free(cache);
+    cache = NULL;
+    return;
+  }
+  fclose(f);
+
+  // every record is at least sizeof(struct crec) bytes long, which bounds nrec
+  hdr = (struct chdr*)cache;
+  size_t size = st.st_size, pos = sizeof(struct chdr);
+  uint64_t i = 0;
+  if ((hdr->magic == CACHE_MAGIC) && (hdr->version == CACHE_VERSION) &&
+      (hdr->nrec <= (size - pos) / sizeof(struct crec))) {
+    for (ctab_size = 64; ctab_size < 2*hdr->nrec; ctab_size *= 2);
+    if ((ctab = calloc(ctab_size, sizeof(struct crec*))) == NULL) panic("OUT OF MEMORY!");
+
+    for (; i < hdr->nrec; i++) {
+      const struct crec *r = (struct crec*)(cache + pos);
+      if (!cacheCheck(r, size - pos)) break;
+      pos += sizeof(struct crec) + r->len;
+
+      size_t h = cacheHash(r->dev, r->ino);
+      while (ctab[h] && ((ctab[h]->dev != r->dev) || (ctab[h]->ino != r->ino))) h = (h + 1) & (ctab_size - 1);
+      if (ctab[h] == NULL) ctab[h] = r;
+    }
+  }
+
+  // on any mismatch, discard the whole cache: all directories are scanned
+  if ((ctab == NULL) || (i != hdr->nrec) || (pos != size)) {
+    fprintf(stderr, "Ignoring invalid cache file '%s'.\n", fn);
+    free(ctab);
+    ctab = NULL;
+    ctab_size = 0;
+    free(cache);
+    cache = NULL;
+  }
+}
+
+
+/// @brief look up the cache record of the directory with stat @a st. The directory's entries
+///        other than subdirectories are stat'ed relative to @a fd and must be unchanged as well.
+///
+/// @param fd descriptor of the directory
+/// @param st stat of the directory
+/// @retval crec* record if the directory is cached and unchanged
+/// @retval NULL otherwise
+static const struct crec* cacheFind(int fd, const struct stat *st)
+{
+  if (ctab_size == 0) return NULL;
+
+  size_t h = cacheHash(st->st_dev, st->st_ino);
+  for (; ctab[h]; h = (h + 1) & (ctab_size - 1)) {
+    const struct crec *r = ctab[h];
+    if ((r->dev == st->st_dev) && (r->ino == st->st_ino)) {
+      if ((r->mtime[0] != st->st_mtim.tv_sec) || (r->mtime[1] != st->st_mtim.tv_nsec) ||
+          (r->ctime[0] != st->st_ctim.tv_sec) || (r->ctime[1] != st->st_ctim.tv_nsec)) {
+        return NULL;
+      }
+
+      // files modified in place do not update the directory's times
+      const struct cfile *cf = (const struct cfile*)(r + 1);
+      const char *name = (const char*)(cf + r->nfile);
+      for (unsigned int i = 0; i < r->nsub; i++) name += strlen(name) + 1;
+      for (unsigned int i = 0; i < r->nfile; i++, name += strlen(name) + 1) {
+        struct stat fst;
+        if ((fstatat(fd, name, &fst, AT_SYMLINK_NOFOLLOW) != 0) ||
+            (fst.st_ino != cf[i].ino) || (fst.st_size != cf[i].size) ||
+            (fst.st_mtim.tv_sec != cf[i].mtime[0]) || (fst.st_mtim.tv_nsec != cf[i].mtime[1]) ||
+            (fst.st_ctim.tv_sec != cf[i].ctime[0]) || (fst.st_ctim.tv_nsec != cf[i].ctime[1])) {
+          return NULL;
+        }
+      }
+      return r;
+    }
+  }
+  return NULL;
+}
+
+
+/// @brief append a cache record to worker @a w's cache records. The other entries of the
+///        directory are taken from @a w->cfile and @a w->cname.
+///
+/// @param w worker
+/// @param st stat of the directory
+/// @param own statistics of the directory's entries
+/// @param sub names of the subdirectories
+/// @param nsub number of subdirectories
+static void cacheAdd(struct worker *w, const struct stat *st, const struct summary *own,
+                     struct splice *sub, unsigned int nsub)
+{
+  struct crec r = {
+    .dev = st->st_dev, .ino = st->st_ino,
+    .mtime = { st->st_mtim.tv_sec, st->st_mtim.tv_nsec },
+    .ctime = { st->st_ctim.tv_sec, st->st_ctim.tv_nsec },
+    .own = *own, .nsub = nsub, .nfile = w->cfile.len / sizeof(struct cfile),
+    .len = w->cfile.len + w->cname.len, .pad = 0,
+  };
+  for (unsigned int i = 0; i < nsub; i++) r.len += strlen(sub[i].child->name) + 1;
+  r.len = (r.len + 7) & ~7;
+
+  ob_write(&w->cache, (char*)&r, sizeof(r));
+  size_t end = w->cache.len + r.len;
+  ob_write(&w->cache, w->cfile.buf, w->cfile.len);
+  for (unsigned int i = 0; i < nsub; i++) {
+    ob_write(&w->cache, sub[i].child->name, strlen(sub[i].child->name) + 1);
+  }
+  ob_write(&w->cache, w->cname.buf, w->cname.len);
+  ob_reserve(&w->cache, end - w->cache.len);
+  memset(w->cache.buf + w->cache.len, 0, end - w->cache.len);
+  w->cache.len = end;
+}
+
+
+/// @brief write the cache records of all workers to cache file @a fn
+static void cacheSave(const char *fn)
+{
+  char *tmp;
+  if (asprintf(&tmp, "%s.tmp", fn) == -1) panic("OUT OF MEMORY!");
+
+  FILE *f = fopen(tmp, "w");
+  if (f == NULL) {
+    fprintf(stderr, "Cannot write cache file '%s': %s.\n", tmp, strerror(errno));
+    free(tmp);
+    return;
+  }
+
+  struct chdr hdr = { CACHE_MAGIC, CACHE_VERSION, 0 };
+  for (unsigned int i = 0; i < nworkers; i++) {
+    for (size_t pos = 0; pos < workers[i].cache.len; hdr.nrec++) {
+      pos += sizeof(struct crec) + ((struct crec*)(workers[i].cache.buf + pos))->len;
+    }
+  }
+
+  int ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+  for (unsigned int i = 0; i < nworkers; i++) {
+    ok &= fwrite(workers[i].cache.buf, 1, workers[i].cache.len, f) == workers[i].cache.len;
+  }
+  ok &= fclose(f) == 0;
+
+  // replace the old cache atomically
+  if (!ok || (rename(tmp, fn) != 0)) {
+    fprintf(stderr, "Cannot write cache file '%s': %s.\n", fn, strerror(errno));
+    unlink(tmp);
+  }
+  free(tmp);
+}
+
+
+/// @brief test whether the file (@a dev, @a ino) has been seen before and add it to the hardlink
+///        set of its device otherwise
+///
+/// @param dev device
+/// @param ino inode number
+/// @retval 1 if the file has been seen before
+/// @retval 0 otherwise
+static int linkSeen(dev_t dev, uint64_t ino)
+{
+  // find the set of the device. Sets are only ever prepended, so the list is walked without lock
+  struct linkset *ls = __atomic_load_n(&linksets, __ATOMIC_ACQUIRE);
+  while (ls && (ls->dev != dev)) ls = ls->next;
+  if (ls == NULL) {
+    pthread_mutex_lock(&linksets_lock);
+    for (ls = linksets; ls && (ls->dev != dev); ls = ls->next);
+    if (ls == NULL) {
+      if ((ls = calloc(1, sizeof(struct linkset))) == NULL) panic("OUT OF MEMORY!");
+      ls->dev = dev;
+      ls->next = linksets;
+      for (int i = 0; i < (1 << LINKSET_BITS); i++) pthread_mutex_init(&ls->shard[i].lock, NULL);
+      __atomic_store_n(&linksets, ls, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&linksets_lock);
+  }
+
+  if (ino == 0) return __atomic_exchange_n(&ls->zero, 1, __ATOMIC_RELAXED);
+
+  // the top bits of the hash select the shard, the low bits the slot
+  uint64_t h = ino * 0x9e3779b97f4a7c15ull;
+  struct lshard *sh = &ls->shard[h >> (64 - LINKSET_BITS)];
+
+  pthread_mutex_lock(&sh->lock);
+  if (4*(sh->n + 1) > 3*sh->cap) {
+    size_t cap = sh->cap ? 2*sh->cap : 1024;
+    uint64_t *tab = calloc(cap, sizeof(uint64_t));
+    if (tab == NULL) panic("OUT OF MEMORY!");
+    for (size_t i = 0; i < sh->cap; i++) {
+      if (sh->ino[i] == 0) continue;
+      size_t j = (sh->ino[i] * 0x9e3779b97f4a7c15ull) & (cap - 1);
+      while (tab[j] != 0) j = (j + 1) & (cap - 1);
+      tab[j] = sh->ino[i];
+    }
+    free(sh->ino);
+    sh->ino = tab;
+    sh->cap = cap;
+  }
+
+  size_t i = h & (sh->cap - 1);
+  while ((sh->ino[i] != 0) && (sh->ino[i] != ino)) i = (i + 1) & (sh->cap - 1);
+  int seen = (sh->ino[i] != 0);
+  if (!seen) {
+    sh->ino[i] = ino;
+    sh->n++;
+  }
+  pthread_mutex_unlock(&sh->lock);
+
+  return seen;
+}
+
+
+/// @brief compare two ranked files: by size, ties broken by path (the smaller path ranks higher)
+///
+/// @retval <0 if @a a ranks lower than @a b
+/// @retval >0 if @a a ranks higher than @a b
+static int tk_cmp(const struct tkent *a, const struct tkent *b)
+{
+  if (a->size != b->size) return (a->size < b->size) ? -1 : 1;
+  return strcmp(b->path, a->path);
+}
+
+
+/// @brief restore the min-heap property of @a h (@a n entries) below position @a i
+static void tk_siftdown(struct tkent *h, unsigned int n, unsigned int i)
+{
+  struct tkent e = h[i];
+  for (unsigned int c; (c = 2*i + 1) < n; i = c) {
+    if ((c + 1 < n) && (tk_cmp(&h[c+1], &h[c]) < 0)) c++;
+    if (tk_cmp(&h[c], &e) >= 0) break;
+    h[i] = h[c];
+  }
+  h[i] = e;
+}
+
+
+/// @brief count the regular file @a name of size @a size in worker @a w's histogram and rank it
+///        among the largest files. The path of its directory is in w->path.
+static void topkAdd(struct worker *w, const char *name, unsigned long long size)
+{
+  unsigned int b = size ? 64 - __builtin_clzll(size) : 0;
+  w->hcount[b]++;
+  w->hbytes[b] += size;
+
+  // reject files smaller than the smallest ranked file without building the path
+  if ((w->ntopk == topk) && (size < w->topk[0].size)) return;
+
+  struct obuf *fp = &w->fpath;
+  size_t n = strlen(name);
+  fp->len = 0;
+  ob_reserve(fp, w->path.len + n + 2);
+  ob_write(fp, w->path.buf, w->path.len);
+  ob_write(fp, "/", 1);
+  ob_write(fp, name, n + 1);
+
+  struct tkent e = { size, fp->buf };
+  if (w->ntopk == topk) {
+    if (tk_cmp(&e, &w->topk[0]) <= 0) return;
+    free(w->topk[0].path);
+    if ((w->topk[0].path = strdup(fp->buf)) == NULL) panic("OUT OF MEMORY!");
+    w->topk[0].size = size;
+    tk_siftdown(w->topk, w->ntopk, 0);
+  } else {
+    if ((w->topk == NULL) && ((w->topk = malloc(topk * sizeof(struct tkent))) == NULL)) panic("OUT OF MEMORY!");
+    if ((e.path = strdup(fp->buf)) == NULL) panic("OUT OF MEMORY!");
+
+    // sift up
+    unsigned int i = w->ntopk++;
+    for (; (i > 0) && (tk_cmp(&e, &w->topk[(i-1)/2]) < 0); i = (i-1)/2) w->topk[i] = w->topk[(i-1)/2];
+    w->topk[i] = e;
+  }
+}
+
+
+/// @brief create a new directory node
+///
+/// @param parent parent directory or NULL for roots. Takes a reference to the parent's descriptor
+/// @param name name of the directory relative to @a parent or path (ownership is transferred)
+/// @retval dnode* new node
+static struct dnode* dn_new(struct dnode *parent, char *name)
+{
+  struct dnode *n = calloc(1, sizeof(struct dnode));
+  if (n == NULL) panic("OUT OF MEMORY!");
+
+  n->name = name;
+  n->parent = parent;
+  n->fd = -1;
+  if (parent) {
+    n->root = parent->root;
+    n->depth = parent->depth + 1;
+    __atomic_add_fetch(&parent->refcnt, 1, __ATOMIC_RELAXED);
+  }
+
+  return n;
+}
+
+
+/// @brief drop a reference to the descriptor of node @a n and close it once unreferenced
+static void dn_release(struct dnode *n)
+{
+  if (__atomic_sub_fetch(&n->refcnt, 1, __ATOMIC_ACQ_REL) == 0) close(n->fd);
+}
+
+
+/// @brief free directory node @a n
+static void dn_free(struct dnode *n)
+{
+  free(n->name);
+  free(n->out.buf);
+  free(n->sp);
+  free(n);
+}
+
+
+/// @brief push node @a n to the bottom of deque @a dq
+static void dq_push(struct deque *dq, struct dnode *n)
+{
+  pthread_mutex_lock(&dq->lock);
+  if (dq->bottom == dq->cap) {
+    if (dq->top > 0) {
+      memmove(dq->node, dq->node + dq->top, (dq->bottom - dq->top) * sizeof(struct dnode*));
+      dq->bottom -= dq->top;
+      dq->top = 0;
+    } else {
+      dq->cap = dq->cap ? 2*dq->cap : 64;
+      dq->node = realloc(dq->node, dq->cap * sizeof(struct dnode*));
+      if (dq->node == NULL) panic("OUT OF MEMORY!");
+    }
+  }
+  dq->node[dq->bottom++] = n;
+  pthread_mutex_unlock(&dq->lock);
+}
+
+
+/// @brief pop the newest node from the bottom of deque @a dq (owner)
+///
+/// @retval dnode* node
+/// @retval NULL if the deque is empty
+static struct dnode* dq_pop(struct deque *dq)
+{
+  struct dnode *n = NULL;
+
+  pthread_mutex_lock(&dq->lock);
+  if (dq->bottom > dq->top) n = dq->node[--dq->bottom];
+  if (dq->bottom == dq->top) dq->top = dq->bottom = 0;
+  pthread_mutex_unlock(&dq->lock);
+
+  return n;
+}
+
+
+/// @brief steal the oldest node from the top of deque @a dq (other workers)
+///
+/// @retval dnode* node
+/// @retval NULL if the deque is empty
+static struct dnode* dq_steal(struct deque *dq)
+{
+  struct dnode *n = NULL;
+
+  pthread_mutex_lock(&dq->lock);
+  if (dq->bottom > dq->top) n = dq->node[dq->top++];
+  pthread_mutex_unlock(&dq->lock);
+
+  return n;
+}
+
+
+/// @brief wake up idle workers after nodes have been pushed
+static void pool_notify(void)
+{
+  if (!parallel) return;
+
+  __atomic_add_fetch(&pool_gen, 1, __ATOMIC_RELEASE);
+  pthread_mutex_lock(&pool_lock);
+  if (pool_idle > 0) pthread_cond_broadcast(&pool_cv);
+  pthread_mutex_unlock(&pool_lock);
+}
+
+
+/// @brief read next directory entry from open directory 'dir'. Ignores '.' and '..' entries
+///
+/// @param dir open DIR* stream
+/// @retval entry on success
+/// @retval NULL on error or if there are no more entries
+struct dirent64 *getNext(DIR *dir)
+{
+  struct dirent64 *next;
+  int ignore;
+
+  do {
+    errno = 0;
+    next = readdir64(dir);
+    if (errno != 0) {
+      return NULL;
+    }
+    ignore = next && ((strcmp(next->d_name, ".") == 0) || (strcmp(next->d_name, "..") == 0));
+  } while (next && ignore);
+
+  return next;
+}
+
+
+#ifdef HAVE_IO_URING
+/// @brief set up an io_uring with URING_ENTRIES submission queue entries
+///
+/// @retval uring* io_uring
+/// @retval NULL if io_uring is not available
+static struct uring* uringSetup(void)
+{
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+
+  int fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+  if (fd < 0) return NULL;
+
+  // IORING_OP_STATX and IORING_REGISTER_PROBE were both added in Linux 5.6; on older kernels the
+  // probe fails
+  struct io_uring_probe *probe = calloc(1, sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op));
+  if (probe == NULL) panic("OUT OF MEMORY!");
+  int statx_ok = (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0) &&
+                 (probe->last_op >= IORING_OP_STATX) &&
+                 (probe->ops[IORING_OP_STATX].flags & IO_URING_OP_SUPPORTED);
+  free(probe);
+  if (!statx_ok) {
+    close(fd);
+    return NULL;
+  }
+
+  // map the rings (a single mapping for both if the kernel supports it) and the SQEs
+  size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+  size_t cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) sq_size = cq_size = (sq_size > cq_size) ? sq_size : cq_size;
+
+  char *sq = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  char *cq = sq;
+  if ((sq != MAP_FAILED) && !(p.features & IORING_FEAT_SINGLE_MMAP)) {
+    cq = mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+  }
+  size_t sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+  void *sqes = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if ((sq == MAP_FAILED) || (cq == MAP_FAILED) || (sqes == MAP_FAILED)) {
+    if (sqes != MAP_FAILED) munmap(sqes, sqes_size);
+    if ((cq != MAP_FAILED) && (cq != sq)) munmap(cq, cq_size);
+    if (sq != MAP_FAILED) munmap(sq, sq_size);
+    close(fd);
+    return NULL;
+  }
+
+  struct uring *r = malloc(sizeof(struct uring));
+  if (r == NULL) panic("OUT OF MEMORY!");
+
+  r->fd       = fd;
+  r->sq_tail  = (unsigned int*)(sq + p.sq_off.tail);
+  r->sq_mask  = (unsigned int*)(sq + p.sq_off.ring_mask);
+  r->sq_array = (unsigned int*)(sq + p.sq_off.array);
+  r->sqes     = sqes;
+  r->cq_head  = (unsigned int*)(cq + p.cq_off.head);
+  r->cq_tail  = (unsigned int*)(cq + p.cq_off.tail);
+  r->cq_mask  = (unsigned int*)(cq + p.cq_off.ring_mask);
+  r->cqes     = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+  return r;
+}
+
+
+/// @brief stat the entries @a e[first..n-1] of directory @a fd with batched IORING_OP_STATX
+///        requests into @a st[first..n-1]
+///
+/// @retval 0 on success
+/// @retval -1 if io_uring is not available (nothing has been stat'ed)
+static int statUring(struct worker *w, int fd, struct dirent64 **e, unsigned int first, unsigned int n,
+                     struct stat *st)
+{
+  if (w->ring == NULL) {
+    if (__atomic_load_n(&uring_failed, __ATOMIC_RELAXED) || ((w->ring = uringSetup()) == NULL)) {
+      __atomic_store_n(&uring_failed, 1, __ATOMIC_RELAXED);
+      return -1;
+    }
+    if ((w->stx = malloc(URING_ENTRIES * sizeof(struct statx))) == NULL) panic("OUT OF MEMORY!");
+  }
+  struct uring *r = w->ring;
+  unsigned int entry[URING_ENTRIES];
+
+  for (unsigned int i = first; i < n; ) {
+    // queue one statx request per entry of the batch; statx buffer k belongs to entry[k]
+    unsigned int tail = *r->sq_tail, nsub = 0;
+    for (; (i < n) && (nsub < URING_ENTRIES); i++) {
+      unsigned int idx = tail & *r->sq_mask;
+      struct io_uring_sqe *sqe = &r->sqes[idx];
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode      = IORING_OP_STATX;
+      sqe->fd          = fd;
+      sqe->addr        = (uintptr_t)e[i]->d_name;
+      sqe->len         = STATX_TYPE | STATX_MODE | STATX_NLINK | STATX_UID | STATX_GID |
+                         STATX_INO | STATX_SIZE | STATX_BLOCKS;
+      sqe->off         = (uintptr_t)&w->stx[nsub];
+      sqe->statx_flags = AT_SYMLINK_NOFOLLOW;
+      sqe->user_data   = nsub;
+      r->sq_array[idx] = idx;
+      entry[nsub++] = i;
+      tail++;
+    }
+    __atomic_store_n(r->sq_tail, tail, __ATOMIC_RELEASE);
+
+    // submit the batch with one system call and reap the completions
+    unsigned int submitted = 0, completed = 0;
+    while (completed < nsub) {
+      long ret = syscall(__NR_io_uring_enter, r->fd, nsub - submitted, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+      if (ret < 0) {
+        if (errno == EINTR) continue;
+        panic("io_uring_enter failed.");
+      }
+      submitted += ret;
+
+      unsigned int head = *r->cq_head;
+      for (; head != __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE); head++, completed++) {
+        struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+        struct stat *t = &st[entry[cqe->user_data]];
+        if (cqe->res < 0) {
+          // e.g., the entry has vanished or the request was rejected: stat it like the fstatat()
+          // path does
+          const char *name = e[entry[cqe->user_data]]->d_name;
+          if (fstatat(fd, name, t, AT_SYMLINK_NOFOLLOW) == -1) panic("  ERROR: No such file or directory");
+          continue;
+        }
+
+        struct statx *x = &w->stx[cqe->user_data];
+        t->st_dev    = makedev(x->stx_dev_major, x->stx_dev_minor);
+        t->st_ino    = x->stx_ino;
+        t->st_mode   = x->stx_mode;
+        t->st_nlink  = x->stx_nlink;
+        t->st_uid    = x->stx_uid;
+        t->st_gid    = x->stx_gid;
+        t->st_size   = x->stx_size;
+        t->st_blocks = x->stx_blocks;
+      }
+      __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+    }
+  }
+
+  return 0;
+}
+#endif
+
+
+/// @brief stat the entries @a e[first..n-1] of directory @a fd into worker @a w's stat array.
+///        Uses io_uring with -u if available.
+///
+/// @retval struct stat* array of the stats (in the order of @a e)
+static struct stat* statEntries(struct worker *w, int fd, struct dirent64 **e, unsigned int first,
+                                unsigned int n)
 {
-  if (msg) fprintf(stderr, "%s\n", msg);
-  exit(EXIT_FAILURE);
+  if (n > w->stcap) {
+    w->stcap = n;
+    if ((w->st = realloc(w->st, n * sizeof(struct stat))) == NULL) panic("OUT OF MEMORY!");
+  }
+
+#ifdef HAVE_IO_URING
+  if ((oflags & F_URING) && (statUring(w, fd, e, first, n, w->st) == 0)) return w->st;
+#endif
+
+  for (unsigned int i = first; i < n; i++) {
+    if (fstatat(fd, e[i]->d_name, &w->st[i], AT_SYMLINK_NOFOLLOW) == -1) panic("  ERROR: No such file or directory");
+  }
+
+  return w->st;
 }
 
 
-/// @brief read next directory entry from open directory 'dir'. Ignores '.' and '..' entries
+/// @brief compare the names of two entries with equal 8-byte prefixes
+static int skey_compare(const void *a, const void *b)
+{
+  return strcmp(((const struct skey*)a)->e->d_name + 8, ((const struct skey*)b)->e->d_name + 8);
+}
+
+
+/// @brief LSD radix sort @a n keys @a k on their prefix, using @a tmp as scratch space
+static void radixSort(struct skey *k, struct skey *tmp, unsigned int n)
+{
+  if (n < 2) return;
+
+  // count all eight bytes in one pass
+  unsigned int cnt[8][256];
+  memset(cnt, 0, sizeof(cnt));
+  for (unsigned int i = 0; i < n; i++) {
+    for (int b = 0; b < 8; b++) cnt[b][(k[i].pfx >> (8*b)) & 0xff]++;
+  }
+
+  struct skey *src = k, *dst = tmp;
+  for (int b = 0; b < 8; b++) {
+    // skip bytes that are the same in all keys (e.g., the padding of short names)
+    if (cnt[b][(src[0].pfx >> (8*b)) & 0xff] == n) continue;
+
+    unsigned int off[256], sum = 0;
+    for (int v = 0; v < 256; v++) {
+      off[v] = sum;
+      sum += cnt[b][v];
+    }
+    for (unsigned int i = 0; i < n; i++) dst[off[(src[i].pfx >> (8*b)) & 0xff]++] = src[i];
+
+    struct skey *t = src;
+    src = dst;
+    dst = t;
+  }
+  if (src != k) memcpy(k, src, n * sizeof(struct skey));
+
+  // names with a common 8-byte prefix are ordered by the rest of the name
+  for (unsigned int i = 0, j; i < n; i = j) {
+    for (j = i + 1; (j < n) && (k[j].pfx == k[i].pfx); j++);
+    if (j - i > 1) qsort(&k[i], j - i, sizeof(struct skey), skey_compare);
+  }
+}
+
+
+/// @brief sort the entries w->ent[0..nent-1] by name, directories first
 ///
-/// @param dir open DIR* stream
-/// @retval entry on success
-/// @retval NULL on error or if there are no more entries
-struct dirent *getNext(DIR *dir)
+/// @param w worker
+/// @param nent number of entries
+/// @retval number of directories (sorted to the front)
+static unsigned int sortEntries(struct worker *w, unsigned int nent)
 {
-  struct dirent *next;
-  int ignore;
+  if (nent > w->keycap) {
+    w->keycap = nent;
+    if ((w->key = realloc(w->key, 2 * nent * sizeof(struct skey))) == NULL) panic("OUT OF MEMORY!");
+  }
 
-  do {
-    errno = 0;
-    next = readdir(dir);
-    if (errno != 0) {
-      return NULL;
+  // build the keys, directories from the front, everything else from the back
+  struct skey *k = w->key;
+  unsigned int ndir = 0, nother = 0;
+  for (unsigned int i = 0; i < nent; i++) {
+    const unsigned char *name = (const unsigned char*)w->ent[i]->d_name;
+    uint64_t pfx = 0;
+    int b = 0;
+    for (; (b < 8) && name[b]; b++) pfx = (pfx << 8) | name[b];
+    pfx <<= 8*(8 - b);
+
+    struct skey *key = (w->ent[i]->d_type == DT_DIR) ? &k[ndir++] : &k[nent - ++nother];
+    key->pfx = pfx;
+    key->e = w->ent[i];
+  }
+
+  radixSort(k, k + nent, ndir);
+  radixSort(k + ndir, k + nent, nother);
+
+  for (unsigned int i = 0; i < nent; i++) w->ent[i] = k[i].e;
+  return ndir;
+}
+
+
+/// @brief index the entries in worker @a w's entry buffer from offset @a pos on and append them
+///        to w->ent[@a nent..]. Ignores '.' and '..' entries.
+///
+/// @retval number of entries in w->ent
+static unsigned int indexEntries(struct worker *w, size_t pos, unsigned int nent)
+{
+  struct obuf *db = &w->dents;
+  while (pos < db->len) {
+    struct dirent64 *e = (struct dirent64*)(db->buf + pos);
+    pos += e->d_reclen;
+
+    if ((strcmp(e->d_name, ".") == 0) || (strcmp(e->d_name, "..") == 0)) continue;
+
+    if (nent == w->entcap) {
+      w->entcap = w->entcap ? 2*w->entcap : 1024;
+      if ((w->ent = realloc(w->ent, w->entcap * sizeof(struct dirent64*))) == NULL) panic("OUT OF MEMORY!");
     }
-    ignore = next && ((strcmp(next->d_name, ".") == 0) || (strcmp(next->d_name, "..") == 0));
-  } while (next && ignore);
+    w->ent[nent++] = e;
+  }
 
-  return next;
+  return nent;
 }
 
 
-/// @brief qsort comparator to sort directory entries. Sorted by name, directories first.
+/// @brief read all entries of open directory @a fd in a single pass into worker @a w's entry
+///        buffers. Ignores '.' and '..' entries.
 ///
-/// @param a pointer to first entry
-/// @param b pointer to second entry
-/// @retval -1 if a<b
-/// @retval 0  if a==b
-/// @retval 1  if a>b
-static int dirent_compare(const void *a, const void *b)
+/// @param fd directory descriptor
+/// @param w worker
+/// @retval number of entries. The entries are in w->ent[0..nent-1]
+static unsigned int readDir(int fd, struct worker *w)
 {
-  struct dirent *e1 = (struct dirent*)a;
-  struct dirent *e2 = (struct dirent*)b;
+  struct obuf *db = &w->dents;
+  db->len = 0;
+
+#ifdef SYS_getdents64
+  // the kernel's linux_dirent64 records have the same layout as struct dirent64. Read them
+  // directly into the (reused) buffer with as few getdents64 calls as possible.
+  while (1) {
+    if (db->cap - db->len < DENTS_BUFSIZE) {
+      size_t cap = db->cap ? 2*db->cap : 4*DENTS_BUFSIZE;
+      if ((db->buf = realloc(db->buf, cap)) == NULL) panic("OUT OF MEMORY!");
+      db->cap = cap;
+    }
 
-  // if one of the entries is a directory, it comes first
-  if (e1->d_type != e2->d_type) {
-    if (e1->d_type == DT_DIR) return -1;
-    if (e2->d_type == DT_DIR) return 1;
+    long n = syscall(SYS_getdents64, fd, db->buf + db->len, db->cap - db->len);
+    if (n <= 0) break;
+    db->len += n;
+  }
+#else
+  DIR *d = fdopendir(dup(fd));
+  struct dirent64 *entry;
+  while ((entry = getNext(d)) != NULL) {
+    if (db->cap - db->len < entry->d_reclen) {
+      size_t cap = db->cap ? 2*db->cap : 4*DENTS_BUFSIZE;
+      if ((db->buf = realloc(db->buf, cap)) == NULL) panic("OUT OF MEMORY!");
+      db->cap = cap;
+    }
+    memcpy(db->buf + db->len, entry, entry->d_reclen);
+    db->len += entry->d_reclen;
   }
+  closedir(d);
+#endif
 
-  // otherwise sorty by name
-  return strcmp(e1->d_name, e2->d_name);
+  return indexEntries(w, 0, 0);
 }
 
 
-/// @brief recursively process directory @a dn and print its tree
+/// @brief read the next chunk of entries of open directory @a fd (-U). Entries already in worker
+///        @a w's entry buffer (the entry held back from the previous chunk) are kept in front.
 ///
-/// @param dn absolute or relative path string
-/// @param pstr prefix string printed in front of each entry
-/// @param stats pointer to statistics
-/// @param flags output control flags (F_*)
-void processDir(const char *dn, const char *pstr, struct summary *stats, unsigned int flags)
+/// @param fd directory descriptor
+/// @param w worker
+/// @param[out] eof set if all entries of the directory have been read
+/// @retval number of entries. The entries are in w->ent[0..nent-1]
+static unsigned int readChunk(int fd, struct worker *w, int *eof)
 {
-  DIR *d = opendir(dn);
-  // erro handling
-  if (errno == EACCES) {
-    printf((flags & F_TREE) ? "%s`-%s\n" : "%s  %s\n", pstr, "ERROR: Permission denied");
-    return;
+#ifdef SYS_getdents64
+  struct obuf *db = &w->dents;
+  unsigned int nent;
+
+  // read until there are two entries (one to process, one to hold back) or the directory ends
+  *eof = 0;
+  do {
+    ob_reserve(db, DENTS_BUFSIZE);
+    long n = syscall(SYS_getdents64, fd, db->buf + db->len, db->cap - db->len);
+    if (n <= 0) *eof = 1;
+    else db->len += n;
+    nent = indexEntries(w, 0, 0);
+  } while (!*eof && (nent < 2));
+
+  return nent;
+#else
+  // without getdents64, read the whole directory
+  *eof = 1;
+  return readDir(fd, w);
+#endif
+}
+
+
+/// @brief process directory node @a dn: render its entries into the node's output buffer and
+///        queue its subdirectories on worker @a w's deque
+///
+/// @param dn directory node
+/// @param w worker processing the node. Statistics are accumulated in the worker's summary
+void processDir(struct dnode *dn, struct worker *w)
+{
+  unsigned int flags = oflags;
+  struct summary *stats = &w->stats;
+
+  // build the prefix from the indents of the ancestors, deepest level last
+  size_t plen = 2*dn->depth;
+  struct obuf *pfx = &w->pfx;
+  pfx->len = 0;
+  ob_reserve(pfx, plen);
+  for (struct dnode *a = dn; a->parent; a = a->parent) {
+    memcpy(pfx->buf + 2*(a->depth - 1), ((flags & F_TREE) && !a->last) ? "| " : "  ", 2);
+  }
+
+  // build the path of the directory for the records from the names of the ancestors
+  if (flags & (F_RECORDS | F_TOPK)) {
+    size_t len = strlen(dn->name);
+    for (struct dnode *a = dn->parent; a; a = a->parent) len += strlen(a->name) + 1;
+
+    struct obuf *path = &w->path;
+    path->len = 0;
+    ob_reserve(path, len + 1);
+    path->len = len;
+    for (struct dnode *a = dn; a; a = a->parent) {
+      size_t n = strlen(a->name);
+      len -= n;
+      memcpy(path->buf + len, a->name, n);
+      if (len > 0) path->buf[--len] = '/';
+    }
+  }
+
+  // open the directory relative to its parent and release the parent's descriptor
+  dn->fd = openat(dn->parent ? dn->parent->fd : AT_FDCWD, dn->name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  int error = errno;
+
+  // in cache mode, directories account for their own size (see Summary cache)
+  struct stat dst;
+  if ((flags & F_CACHE) && dn->parent) {
+    if (((dn->fd >= 0) ? fstat(dn->fd, &dst) : fstatat(dn->parent->fd, dn->name, &dst, AT_SYMLINK_NOFOLLOW)) == 0) {
+      stats->size   += dst.st_size;
+      stats->blocks += dst.st_blocks;
+    }
+  }
+  if (dn->parent) dn_release(dn->parent);
+
+  // with -x, do not descend into directories on other devices than the root
+  if ((flags & F_XDEV) && (dn->fd >= 0)) {
+    struct stat xst;
+    if (fstat(dn->fd, &xst) != 0) panic("  ERROR: No such file or directory");
+    if (dn->parent == NULL) {
+      dn->root->dev = xst.st_dev;
+    } else if (xst.st_dev != dn->root->dev) {
+      close(dn->fd);
+      dn->fd = -1;
+      return;
+    }
   }
-  else if (errno == ENOTDIR) {
-    printf("  ERROR: Not a directory\n");
+
+  // erro handling
+  if ((dn->fd < 0) && (flags & F_RECORDS)) {
+    fprintf(stderr, "%.*s: %s\n", (int)w->path.len, w->path.buf, strerror(error));
     return;
   }
-  else if (d == NULL) {
-    printf("  ERROR: No such file or directory\n");
+  else if (dn->fd < 0) {
+    if (error == EACCES) {
+      ob_printf(&dn->out, (flags & F_TREE) ? "%.*s`-%s\n" : "%.*s  %s\n", (int)plen, pfx->buf, "ERROR: Permission denied");
+    }
+    else if (error == ENOTDIR) {
+      ob_printf(&dn->out, "  ERROR: Not a directory\n");
+    }
+    else {
+      ob_printf(&dn->out, "  ERROR: No such file or directory\n");
+    }
     return;
   }
-  struct dirent *entry;
-  
-  // determine number of entries before storing entries in dir for dynamic mem allocation
-  unsigned int nent = 0;
-  while((entry = getNext(d)) != NULL) {
-    nent++;
-  }
-  struct dirent *entries = malloc(sizeof(struct dirent)*nent);
-  
-  // store every entries in dirent array
-  int i = 0;
-  d = opendir(dn);
-  while((entry = getNext(d)) != NULL) {
-    entries[i++] = *entry;
-  }
-
-  // sort in order of dir and filename using dirent comparator
-  qsort(entries, nent, sizeof(entries[0]), dirent_compare);
-
-  for (unsigned int pos = 0; pos < nent; pos++) {
-    struct dirent *this = &entries[pos];
-    
-    char *fn, *out, *tmp;
-    // handling path string
-    if (asprintf(&fn, "%s/%s", dn, this->d_name) == -1) panic("OUT OF MEMORY!");
-    
-    // handling output prefix format string
-    if (flags & F_TREE) {
-      if (pos == nent - 1) {
-        if (asprintf(&out, "%s", pstr) == -1) panic("OUT OF MEMORY!");
-        if (asprintf(&tmp, "%s`-%s", out, this->d_name) == -1) panic("OUT OF MEMORY!");
-        if (asprintf(&out, "%s  ", out) == -1) panic("OUT OF MEMORY!");
-      } else {
-        if (asprintf(&out, "%s|", pstr) == -1) panic("OUT OF MEMORY!");
-        if (asprintf(&tmp, "%s-%s", out, this->d_name) == -1) panic("OUT OF MEMORY!");
-        if (asprintf(&out, "%s ", out) == -1) panic("OUT OF MEMORY!");
+  dn->refcnt = 1;
+
+  struct summary before = *stats;
+  if (flags & F_CACHE) {
+    if (!dn->parent && (fstat(dn->fd, &dst) != 0)) panic("  ERROR: No such file or directory");
+
+    const struct crec *r = cacheFind(dn->fd, &dst);
+    if (r != NULL) {
+      // unchanged: use the cached summary and visit the cached subdirectories
+      stats->dirs   += r->own.dirs;
+      stats->files  += r->own.files;
+      stats->links  += r->own.links;
+      stats->fifos  += r->own.fifos;
+      stats->socks  += r->own.socks;
+      stats->size   += r->own.size;
+      stats->blocks += r->own.blocks;
+
+      if ((r->nsub > 0) && ((dn->sp = malloc(r->nsub * sizeof(struct splice))) == NULL)) panic("OUT OF MEMORY!");
+      const char *name = (const char*)((const struct cfile*)(r + 1) + r->nfile);
+      for (unsigned int i = 0; i < r->nsub; i++, name += strlen(name) + 1) {
+        char *n = strdup(name);
+        if (n == NULL) panic("OUT OF MEMORY!");
+        dn->sp[dn->nsp].pos = 0;
+        dn->sp[dn->nsp].child = dn_new(dn, n);
+        dn->nsp++;
       }
-    } else {
-      if (asprintf(&out, "%s  ", pstr) == -1) panic("OUT OF MEMORY!");
-      if (asprintf(&tmp, "%s%s", out, this->d_name) == -1) panic("OUT OF MEMORY!");
+      ob_write(&w->cache, (const char*)r, sizeof(struct crec) + r->len);
+
+      for (unsigned int s = dn->nsp; s > 0; s--) dq_push(&w->dq, dn->sp[s-1].child);
+      if (dn->nsp > 0) pool_notify();
+
+      dn_release(dn);
+      return;
     }
-     
-    if (flags & F_VERBOSE) {
-      struct stat st;
-      if (lstat(fn, &st) == -1) panic("  ERROR: No such file or directory");
-      
-      if (strlen(tmp) > 54) {
-        strncpy(tmp + 51, "...\0", 4);
-      }
-      printf("%-54s  ", tmp);
-      
-      unsigned char type = (this->d_type == DT_REG)  ? ' ' : 
-                           (this->d_type == DT_DIR)  ? 'd' : 
-                           (this->d_type == DT_LNK)  ? 'l' : 
-                           (this->d_type == DT_CHR)  ? 'c' : 
-                           (this->d_type == DT_BLK)  ? 'b' : 
-                           (this->d_type == DT_FIFO) ? 'f' : 
+  }
+
+  unsigned int nent, ndir = 0;
+  int eof = 1;
+  w->cfile.len = w->cname.len = 0;
+  if (flags & F_UNSORTED) {
+    // directory order, one chunk at a time (see Sorting)
+    w->dents.len = 0;
+    nent = readChunk(dn->fd, w, &eof);
+  } else {
+    // sort by name, directories first; reserve one splice point for each directory
+    nent = readDir(dn->fd, w);
+    ndir = sortEntries(w, nent);
+    if ((ndir > 0) && ((dn->sp = malloc(ndir * sizeof(struct splice))) == NULL)) panic("OUT OF MEMORY!");
+  }
+
+  while (1) {
+    // with -U, the last entry of a chunk is held back until the next chunk has been read
+    unsigned int n = eof ? nent : nent - 1;
+    struct dirent64 **entries = w->ent;
+
+    // stat all entries at once (in cache mode, subdirectories account for themselves)
+    struct stat *sts = NULL;
+    if (flags & (F_VERBOSE | F_RECORDS | F_TOPK)) sts = statEntries(w, dn->fd, entries, (flags & F_CACHE) ? ndir : 0, n);
+
+    for (unsigned int pos = 0; pos < n; pos++) {
+      struct dirent64 *this = entries[pos];
+      int last = eof && (pos == nent - 1);
+
+      unsigned char type = (this->d_type == DT_REG)  ? ' ' :
+                           (this->d_type == DT_DIR)  ? 'd' :
+                           (this->d_type == DT_LNK)  ? 'l' :
+                           (this->d_type == DT_CHR)  ? 'c' :
+                           (this->d_type == DT_BLK)  ? 'b' :
+                           (this->d_type == DT_FIFO) ? 'f' :
                            (this->d_type == DT_SOCK) ? 's' : '?';
-      
-      // if directory type is unknown
-      if (type == '?') {
-        printf("File type could not be determined\n");
-        free(fn);
-        free(out);
-        free(tmp);
-        continue;
-      }
-      
-      // accumulate number of files/dirs/links/pipes/sockets/blocks and size
+
+      // accumulate number of files/dirs/links/pipes/sockets
       stats->dirs   += (type == 'd');
       stats->files  += (type == ' ');
       stats->links  += (type == 'l');
       stats->fifos  += (type == 'f');
       stats->socks  += (type == 's');
-      stats->size   += st.st_size;
-      stats->blocks += st.st_blocks;
-      
-      // extract user/group id from stat and find corresponding user/group name
-      printf("%8s:%-8s  %10ld  %8ld  %c\n", 
-             getpwuid(st.st_uid)->pw_name, 
-             getgrgid(st.st_gid)->gr_name, 
-             st.st_size, 
-             st.st_blocks, 
-             type);
-      
+
+      struct stat *st = sts ? &sts[pos] : NULL;
+      if (sts && !((flags & F_CACHE) && (this->d_type == DT_DIR))) {
+        // remember the entry's identity, size and times to validate the cache record
+        if (flags & F_CACHE) {
+          struct cfile cf = {
+            .ino = st->st_ino, .size = st->st_size,
+            .mtime = { st->st_mtim.tv_sec, st->st_mtim.tv_nsec },
+            .ctime = { st->st_ctim.tv_sec, st->st_ctim.tv_nsec },
+          };
+          ob_write(&w->cfile, (char*)&cf, sizeof(cf));
+          ob_write(&w->cname, this->d_name, strlen(this->d_name) + 1);
+        }
+
+        // accumulate size and blocks (hardlinked files only once with -d)
+        if ((type != '?') &&
+            (!(flags & F_DEDUP) || (st->st_nlink < 2) || S_ISDIR(st->st_mode) || !linkSeen(st->st_dev, st->st_ino))) {
+          stats->size   += st->st_size;
+          stats->blocks += st->st_blocks;
+          if ((flags & F_TOPK) && (type == ' ')) topkAdd(w, this->d_name, st->st_size);
+        }
+      }
+
+      if (flags & F_RECORDS) {
+        recEntry(w, this->d_name, type, st);
+      } else if (!(flags & (F_CACHE | F_TOPK))) {
+        // render prefix, connector and name directly into the output buffer
+        size_t start = dn->out.len;
+        ob_write(&dn->out, pfx->buf, plen);
+        ob_write(&dn->out, (flags & F_TREE) ? (last ? "`-" : "|-") : "  ", 2);
+        ob_write(&dn->out, this->d_name, strlen(this->d_name));
+
+        if (flags & F_VERBOSE) {
+          // cut names that are too long and pad to the column width
+          size_t len = dn->out.len - start;
+          if (len > 54) {
+            memcpy(dn->out.buf + start + 51, "...", 3);
+            dn->out.len = start + (len = 54);
+          }
+          ob_printf(&dn->out, "%*s", (int)(56 - len), "");
+
+          // if directory type is unknown
+          if (type == '?') {
+            ob_printf(&dn->out, "File type could not be determined\n");
+            continue;
+          }
+
+          // extract user/group id from stat and find corresponding user/group name
+          ob_printf(&dn->out, "%8s:%-8s  %10ld  %8ld  %c\n",
+                    idName(&users, st->st_uid),
+                    idName(&groups, st->st_gid),
+                    st->st_size,
+                    st->st_blocks,
+                    type);
+
+        } else {
+          ob_write(&dn->out, "\n", 1);
+        }
+      }
+      if (this->d_type == DT_DIR) {
+        // the subdirectory's output follows this line
+        char *name = strdup(this->d_name);
+        if (name == NULL) panic("OUT OF MEMORY!");
+        struct dnode *child = dn_new(dn, name);
+        child->last = last;
+        if ((flags & F_UNSORTED) && ((dn->nsp == 0) || ((dn->nsp >= 4) && !(dn->nsp & (dn->nsp - 1))))) {
+          if ((dn->sp = realloc(dn->sp, (dn->nsp ? 2*dn->nsp : 4) * sizeof(struct splice))) == NULL) panic("OUT OF MEMORY!");
+        }
+        dn->sp[dn->nsp].pos = dn->out.len;
+        dn->sp[dn->nsp].child = child;
+        dn->nsp++;
+      }
+    }
+
+    if (eof) break;
+
+    // sequential traversal: all output before this directory has been emitted. Write the listing
+    // directly until a subdirectory's output has to be spliced in
+    if (!parallel && (dn->nsp == 0) && (dn->out.len > 0)) {
+      fwrite(dn->out.buf, 1, dn->out.len, stdout);
+      dn->out.len = 0;
+    }
+
+    // keep the held-back entry and read the next chunk
+    struct dirent64 *held = entries[nent - 1];
+    memmove(w->dents.buf, held, held->d_reclen);
+    w->dents.len = held->d_reclen;
+    nent = readChunk(dn->fd, w, &eof);
+  }
+
+  // record the summary of the directory's own entries in the cache
+  if (flags & F_CACHE) {
+    struct summary own = {
+      stats->dirs - before.dirs, stats->files - before.files, stats->links - before.links,
+      stats->fifos - before.fifos, stats->socks - before.socks,
+      stats->size - before.size, stats->blocks - before.blocks
+    };
+    cacheAdd(w, &dst, &own, dn->sp, dn->nsp);
+  }
+
+  // queue subdirectories in reverse order so that the owner pops them in output order
+  for (unsigned int s = dn->nsp; s > 0; s--) dq_push(&w->dq, dn->sp[s-1].child);
+  if (dn->nsp > 0) pool_notify();
+
+  dn_release(dn);
+}
+
+
+/// @brief process node @a n on worker @a w, merge the statistics into the summary of its root and
+///        mark it done
+static void runNode(struct worker *w, struct dnode *n)
+{
+  processDir(n, w);
+
+  struct summary *s = &w->stats, *t = &n->root->stats;
+  pthread_mutex_lock(&n->root->lock);
+  t->dirs   += s->dirs;
+  t->files  += s->files;
+  t->links  += s->links;
+  t->fifos  += s->fifos;
+  t->socks  += s->socks;
+  t->size   += s->size;
+  t->blocks += s->blocks;
+  pthread_mutex_unlock(&n->root->lock);
+  memset(s, 0, sizeof(*s));
+
+  // records must be written before the summary record of the root
+  recFlush(w);
+
+  if (parallel) {
+    pthread_mutex_lock(&done_lock);
+    __atomic_store_n(&n->done, 1, __ATOMIC_RELEASE);
+    if (waiting == n) pthread_cond_signal(&done_cv);
+    pthread_mutex_unlock(&done_lock);
+  } else {
+    n->done = 1;
+  }
+}
+
+
+/// @brief worker thread: process own nodes, steal from others if out of work
+///
+/// @param arg struct worker*
+static void* workerMain(void *arg)
+{
+  struct worker *w = arg;
+
+  while (1) {
+    unsigned long gen = __atomic_load_n(&pool_gen, __ATOMIC_ACQUIRE);
+
+    struct dnode *n = dq_pop(&w->dq);
+    for (unsigned int i = 1; (n == NULL) && (i < nworkers); i++) {
+      n = dq_steal(&workers[(w->id + i) % nworkers].dq);
+    }
+
+    if (n != NULL) {
+      runNode(w, n);
+      continue;
+    }
+
+    // no work: sleep until new nodes are pushed or the pool is shut down
+    pthread_mutex_lock(&pool_lock);
+    if (pool_shutdown) {
+      pthread_mutex_unlock(&pool_lock);
+      break;
+    }
+    if (gen == __atomic_load_n(&pool_gen, __ATOMIC_ACQUIRE)) {
+      pool_idle++;
+      pthread_cond_wait(&pool_cv, &pool_lock);
+      pool_idle--;
+    }
+    pthread_mutex_unlock(&pool_lock);
+  }
+
+  return NULL;
+}
+
+
+/// @brief check whether node @a n has been processed. In parallel mode, block until it is.
+static int nodeReady(struct dnode *n)
+{
+  if (!parallel) return n->done;
+  if (__atomic_load_n(&n->done, __ATOMIC_ACQUIRE)) return 1;
+
+  pthread_mutex_lock(&done_lock);
+  while (!n->done) {
+    waiting = n;
+    pthread_cond_wait(&done_cv, &done_lock);
+  }
+  waiting = NULL;
+  pthread_mutex_unlock(&done_lock);
+
+  return 1;
+}
+
+
+/// @brief emit the output of all processed nodes in order and free them
+///
+/// @retval 1 if the output of all nodes on the cursor stack has been emitted
+/// @retval 0 if a node has not been processed yet (sequential mode only)
+static int emit(void)
+{
+  while (edepth > 0) {
+    struct cursor *c = &estack[edepth-1];
+    struct dnode *n = c->node;
+    if (!nodeReady(n)) return 0;
+
+    size_t end = (c->sp < n->nsp) ? n->sp[c->sp].pos : n->out.len;
+    if (end > c->pos) fwrite(n->out.buf + c->pos, 1, end - c->pos, stdout);
+    c->pos = end;
+
+    if (c->sp < n->nsp) {
+      // descend into the next subdirectory
+      struct dnode *child = n->sp[c->sp++].child;
+      if (edepth == ecap) {
+        ecap = ecap ? 2*ecap : 64;
+        if ((estack = realloc(estack, ecap * sizeof(struct cursor))) == NULL) panic("OUT OF MEMORY!");
+      }
+      estack[edepth++] = (struct cursor){ child, 0, 0 };
     } else {
-      printf("%s\n", tmp);
+      dn_free(n);
+      edepth--;
     }
-    if (this->d_type == DT_DIR) {
-      // recurse with relative path, output prefix format string, accumulated stats, flag mode
-      processDir(fn, out, stats, flags);
+  }
+
+  return 1;
+}
+
+
+/// @brief start the traversal of root @a r with path @a dn
+///
+/// @param r root
+/// @param dn absolute or relative path string
+static void startTree(struct root *r, const char *dn)
+{
+  static unsigned int next;
+
+  char *path = strdup(dn);
+  if (path == NULL) panic("OUT OF MEMORY!");
+
+  r->path = dn;
+  r->node = dn_new(NULL, path);
+  r->node->root = r;
+  pthread_mutex_init(&r->lock, NULL);
+
+  // spread the roots over the workers
+  dq_push(&workers[next++ % nworkers].dq, r->node);
+  pool_notify();
+}
+
+
+/// @brief finish the traversal of root @a r and print its tree. On return, r->stats holds the
+///        statistics of the tree.
+///
+/// @param r root
+static void finishTree(struct root *r)
+{
+  ecap = ecap ? ecap : 64;
+  if ((estack == NULL) && ((estack = malloc(ecap * sizeof(struct cursor))) == NULL)) panic("OUT OF MEMORY!");
+  estack[0] = (struct cursor){ r->node, 0, 0 };
+  edepth = 1;
+
+  if (parallel) {
+    emit();
+  } else {
+    // sequential: process nodes depth-first and emit the output as soon as it is available
+    struct dnode *n;
+    while ((n = dq_pop(&workers[0].dq)) != NULL) {
+      runNode(&workers[0], n);
+      emit();
     }
-    free(fn);
-    free(out);
-    free(tmp);
+  }
+}
+
+
+/// @brief append a copy of path @a dn to the directory list @a dirs
+///
+/// @param dn path
+/// @param[in,out] dirs directory list
+/// @param[in,out] ndir number of directories in @a dirs
+/// @param[in,out] cap capacity of @a dirs
+static void addDirectory(const char *dn, const char ***dirs, int *ndir, int *cap)
+{
+  if (*ndir == *cap) {
+    *cap = *cap ? 2 * *cap : 64;
+    if ((*dirs = realloc(*dirs, *cap * sizeof(char*))) == NULL) panic("OUT OF MEMORY!");
+  }
+  if (((*dirs)[(*ndir)++] = strdup(dn)) == NULL) panic("OUT OF MEMORY!");
+}
+
+
+/// @brief read paths from file @a fn (one per line, "-" for stdin) and append them to the list
+///        of directories @a dirs
+///
+/// @param fn file name
+/// @param[in,out] dirs list of directories
+/// @param[in,out] ndir number of directories
+/// @param[in,out] cap capacity of @a dirs
+static void readDirectories(const char *fn, const char ***dirs, int *ndir, int *cap)
+{
+  FILE *f = strcmp(fn, "-") ? fopen(fn, "r") : stdin;
+  if (f == NULL) {
+    fprintf(stderr, "Cannot open '%s': %s.\n", fn, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  char *line = NULL;
+  size_t size = 0;
+  ssize_t len;
+  while ((len = getline(&line, &size, f)) != -1) {
+    if ((len > 0) && (line[len-1] == '\n')) line[--len] = '\0';
+    if (len == 0) continue;
+
+    addDirectory(line, dirs, ndir, cap);
+  }
+
+  free(line);
+  if (f != stdin) fclose(f);
+}
+
+
+/// @brief print the summary record of root directory @a dn (-o)
+///
+/// @param dn root directory
+/// @param s statistics of @a dn
+static void recSummary(const char *dn, struct summary *s)
+{
+  struct obuf rec = { 0 };
+
+  if (oflags & F_JSON) {
+    ob_write(&rec, "{\"root\":", 8);
+    ob_quote(&rec, dn, strlen(dn), oflags);
+    ob_printf(&rec, ",\"type\":\"summary\",\"size\":%llu,\"blocks\":%llu,\"dirs\":%u,\"files\":%u,"
+                    "\"links\":%u,\"fifos\":%u,\"socks\":%u}\n",
+              s->size, s->blocks, s->dirs, s->files, s->links, s->fifos, s->socks);
+  } else {
+    ob_quote(&rec, dn, strlen(dn), oflags);
+    ob_printf(&rec, ",summary,%llu,%llu,,,%u,%u,%u,%u,%u\n",
+              s->size, s->blocks, s->dirs, s->files, s->links, s->fifos, s->socks);
+  }
+
+  pthread_mutex_lock(&out_lock);
+  fwrite(rec.buf, 1, rec.len, stdout);
+  pthread_mutex_unlock(&out_lock);
+  free(rec.buf);
+}
+
+
+/// @brief format size @a v with a binary unit suffix into @a buf
+static const char* hsize(unsigned long long v, char buf[24])
+{
+  const char *unit = "KMGTPE";
+  int u = -1;
+  while ((v >= 1024) && (v % 1024 == 0)) {
+    v /= 1024;
+    u++;
+  }
+  if (u < 0) snprintf(buf, 24, "%llu", v);
+  else snprintf(buf, 24, "%llu%c", v, unit[u]);
+  return buf;
+}
+
+
+/// @brief merge the largest files and the size histograms of all workers and print them (-k)
+static void printTopk(void)
+{
+  unsigned long long hcount[HIST_BUCKETS] = { 0 }, hbytes[HIST_BUCKETS] = { 0 };
+  unsigned int n = 0;
+  struct tkent *all = malloc(nworkers * topk * sizeof(struct tkent));
+  if (all == NULL) panic("OUT OF MEMORY!");
+
+  for (unsigned int i = 0; i < nworkers; i++) {
+    struct worker *w = &workers[i];
+    memcpy(&all[n], w->topk, w->ntopk * sizeof(struct tkent));
+    n += w->ntopk;
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+      hcount[b] += w->hcount[b];
+      hbytes[b] += w->hbytes[b];
+    }
+  }
+
+  // rank: heapify all candidates and pop the smallest until topk are left, then sort those
+  for (unsigned int i = n/2; i-- > 0; ) tk_siftdown(all, n, i);
+  while (n > topk) {
+    free(all[0].path);
+    all[0] = all[--n];
+    tk_siftdown(all, n, 0);
+  }
+  for (unsigned int i = n; i > 1; i--) {
+    struct tkent e = all[0];
+    all[0] = all[i-1];
+    tk_siftdown(all, i - 1, 0);
+    all[i-1] = e;
+  }
+
+  printf("Largest files:\n"
+         "  %16s  %s\n", "Size", "Path");
+  for (unsigned int i = 0; i < n; i++) {
+    printf("  %16llu  %s\n", all[i].size, all[i].path);
+    free(all[i].path);
+  }
+  free(all);
+
+  int first = 0, last = HIST_BUCKETS - 1;
+  while ((first < last) && (hcount[first] == 0)) first++;
+  while ((last > first) && (hcount[last] == 0)) last--;
+
+  printf("\nFile size histogram:\n"
+         "  %-16s  %16s  %20s\n", "Size", "Files", "Bytes");
+  for (int b = first; b <= last; b++) {
+    char lo[24], hi[24], range[56];
+    if (b == 0) snprintf(range, sizeof(range), "0");
+    else if (b == 64) snprintf(range, sizeof(range), "%s-", hsize(1ull << 63, lo));
+    else snprintf(range, sizeof(range), "%s-%s", hsize(1ull << (b-1), lo), hsize(1ull << b, hi));
+    printf("  %-16s  %16llu  %20llu\n", range, hcount[b], hbytes[b]);
   }
 }
 
@@ -237,7 +1975,8 @@ void syntax(const char *argv0, const char *error, ...)
 
   assert(argv0 != NULL);
 
-  fprintf(stderr, "Usage %s [-t] [-s] [-v] [-h] [path...]\n"
+  fprintf(stderr, "Usage %s [-t] [-s] [-v] [-o json|csv] [-c FILE] [-u] [-x] [-d] [-U] [-k N] [-j N]\n"
+                  "          [-f FILE] [-h] [path...]\n"
                   "Gather information about directory trees. If no path is given, the current directory\n"
                   "is analyzed.\n"
                   "\n"
@@ -245,9 +1984,21 @@ void syntax(const char *argv0, const char *error, ...)
                   " -t        print the directory tree (default if no other option specified)\n"
                   " -s        print summary of directories (total number of files, total file size, etc)\n"
                   " -v        print detailed information for each file. Turns on tree view.\n"
+                  " -o FMT    print one record per entry and a summary record per path instead.\n"
+                  "           FMT is 'json' (JSON lines) or 'csv'.\n"
+                  " -c FILE   print only the summaries; skip unchanged directories using the summary\n"
+                  "           cache FILE (created if it does not exist)\n"
+                  " -u        stat entries in batches with io_uring (if available)\n"
+                  " -x        do not descend into directories on other file systems\n"
+                  " -d        count the size of hardlinked files only once (like du)\n"
+                  " -U        do not sort; list entries in directory order\n"
+                  " -k N      print only the N largest files and a histogram of the file sizes\n"
+                  "           (and the summaries with -s)\n"
+                  " -j N      traverse directories with N threads (1-%d, default 1)\n"
+                  " -f FILE   read additional paths from FILE, one per line ('-' for stdin)\n"
                   " -h        print this help\n"
-                  " path...   list of space-separated paths (max %d). Default is the current directory.\n",
-                  basename(argv0), MAX_DIR);
+                  " path...   list of space-separated paths. Default is the current directory.\n",
+                  basename(argv0), MAX_THREADS);
 
   exit(EXIT_FAILURE);
 }
@@ -260,11 +2011,12 @@ int main(int argc, char *argv[])
   // default directory is the current directory (".")
   //
   const char CURDIR[] = ".";
-  const char *directories[MAX_DIR];
-  int   ndir = 0;
+  const char **directories = NULL;   // strdup'd paths, freed at exit
+  int   ndir = 0, dcap = 0;
 
   struct summary dstat, tstat;
   unsigned int flags = 0;
+  const char *cachefn = NULL;
 
   //
   // parse arguments
@@ -275,47 +2027,127 @@ int main(int argc, char *argv[])
       if      (!strcmp(argv[i], "-t")) flags |= F_TREE;
       else if (!strcmp(argv[i], "-s")) flags |= F_SUMMARY;
       else if (!strcmp(argv[i], "-v")) flags |= F_VERBOSE;
+      else if (!strcmp(argv[i], "-u")) flags |= F_URING;
+      else if (!strcmp(argv[i], "-x")) flags |= F_XDEV;
+      else if (!strcmp(argv[i], "-U")) flags |= F_UNSORTED;
+      else if (!strcmp(argv[i], "-d")) flags |= F_DEDUP;
       else if (!strcmp(argv[i], "-h")) syntax(argv[0], NULL);
+      else if (!strcmp(argv[i], "-o")) {
+        if (++i == argc) syntax(argv[0], "Missing argument to '-o'.");
+        if      (!strcmp(argv[i], "json")) flags = (flags & ~F_RECORDS) | F_JSON;
+        else if (!strcmp(argv[i], "csv"))  flags = (flags & ~F_RECORDS) | F_CSV;
+        else syntax(argv[0], "Invalid output format '%s'.", argv[i]);
+      }
+      else if (!strcmp(argv[i], "-c")) {
+        if (++i == argc) syntax(argv[0], "Missing argument to '-c'.");
+        cachefn = argv[i];
+        flags |= F_CACHE | F_SUMMARY | F_VERBOSE;
+      }
+      else if (!strcmp(argv[i], "-f")) {
+        if (++i == argc) syntax(argv[0], "Missing argument to '-f'.");
+        readDirectories(argv[i], &directories, &ndir, &dcap);
+      }
+      else if (!strcmp(argv[i], "-k")) {
+        char *end;
+        if (++i == argc) syntax(argv[0], "Missing argument to '-k'.");
+        long n = strtol(argv[i], &end, 10);
+        if ((*end != '\0') || (n < 1) || (n > 1000000)) {
+          syntax(argv[0], "Invalid number of files '%s'.", argv[i]);
+        }
+        topk = n;
+        flags |= F_TOPK | F_UNSORTED;   // nothing is listed, so there is nothing to sort
+      }
+      else if (!strcmp(argv[i], "-j")) {
+        char *end;
+        if (++i == argc) syntax(argv[0], "Missing argument to '-j'.");
+        long n = strtol(argv[i], &end, 10);
+        if ((*end != '\0') || (n < 1) || (n > MAX_THREADS)) {
+          syntax(argv[0], "Invalid number of threads '%s'.", argv[i]);
+        }
+        nworkers = n;
+      }
       else syntax(argv[0], "Unrecognized option '%s'.", argv[i]);
     } else {
       // anything else is recognized as a directory
-      if (ndir < MAX_DIR) {
-        directories[ndir++] = argv[i];
-      } else {
-        printf("Warning: maximum number of directories exceeded, ignoring '%s'.\n", argv[i]);
-      }
+      addDirectory(argv[i], &directories, &ndir, &dcap);
     }
   }
 
+  if ((flags & F_CACHE) && (flags & F_RECORDS)) syntax(argv[0], "'-c' cannot be combined with '-o'.");
+  if ((flags & F_CACHE) && (flags & F_DEDUP)) syntax(argv[0], "'-c' cannot be combined with '-d'.");
+  if ((flags & F_TOPK) && (flags & (F_CACHE | F_RECORDS))) syntax(argv[0], "'-k' cannot be combined with '-c' or '-o'.");
+
   // if no directory was specified, use the current directory
-  if (ndir == 0) directories[ndir++] = CURDIR;
+  if (ndir == 0) addDirectory(CURDIR, &directories, &ndir, &dcap);
+
+  //
+  // set up workers. With a single worker, the main thread traverses the directories itself.
+  //
+  oflags = flags;
+  if (cachefn) cacheLoad(cachefn);
+  if (!isatty(STDOUT_FILENO)) setvbuf(stdout, NULL, _IOFBF, STDOUT_BUFSIZE);
+  if ((workers = calloc(nworkers, sizeof(struct worker))) == NULL) panic("OUT OF MEMORY!");
+  for (unsigned int i = 0; i < nworkers; i++) {
+    workers[i].id = i;
+    pthread_mutex_init(&workers[i].dq.lock, NULL);
+  }
+  parallel = nworkers > 1;
+  if (parallel) {
+    for (unsigned int i = 0; i < nworkers; i++) {
+      if (pthread_create(&workers[i].thread, NULL, workerMain, &workers[i]) != 0) {
+        panic("Cannot create worker thread.");
+      }
+    }
+  }
 
   //
-  // process each directory
+  // process each directory. Up to 'window' roots are traversed concurrently, output is in order.
   //
+  struct root *roots = calloc(ndir, sizeof(struct root));
+  int started = 0, window = (parallel && !(flags & F_DEDUP)) ? 4*nworkers : 1;
+  if (roots == NULL) panic("OUT OF MEMORY!");
+
   memset(&tstat, 0, sizeof(tstat));
+  if (flags & F_CSV) printf("path,type,size,blocks,uid,gid,dirs,files,links,fifos,socks\n");
   for (int i = 0; i < ndir; i++) {
-    memset(&dstat, 0, sizeof(dstat));
-    
-    if (flags & F_SUMMARY) {
-      printf("Name                                                        User:Group           Size    Blocks Type\n");
-      printf("----------------------------------------------------------------------------------------------------\n");
-    }
-    printf("%s\n", directories[i]);
-    processDir(directories[i], "", &dstat, flags);
-    if (flags & F_SUMMARY) {
-      char *summary, *files, *dirs, *links, *fifos, *socks;
-      // summary line taking care to output grammatically correct English (singular and plural)
-      if (asprintf(&files, (dstat.files == 1) ? "%d file" : "%d files", dstat.files) == -1) panic("OUT OF MEMORY!");
-      if (asprintf(&dirs, (dstat.dirs == 1) ? "%d directory" : "%d directories", dstat.dirs) == -1) panic("OUT OF MEMORY!");
-      if (asprintf(&links, (dstat.links == 1) ? "%d link" : "%d links", dstat.links) == -1) panic("OUT OF MEMORY!");
-      if (asprintf(&fifos, (dstat.fifos == 1) ? "%d pipe" : "%d pipes", dstat.fifos) == -1) panic("OUT OF MEMORY!");
-      if (asprintf(&socks, (dstat.socks == 1) ? "%d socket" : "%d sockets", dstat.socks) == -1) panic("OUT OF MEMORY!");
-      if (asprintf(&summary, "%s, %s, %s, %s, and %s", files, dirs, links, fifos, socks) == -1) panic("OUT OF MEMORY!");
-      printf("----------------------------------------------------------------------------------------------------\n");
-      printf("%-68s   %14lld %9lld\n\n", summary, dstat.size, dstat.blocks);
-    }
-    
+    for (; (started < ndir) && (started < i + window); started++) {
+      startTree(&roots[started], directories[started]);
+    }
+
+    if (flags & F_RECORDS) {
+      finishTree(&roots[i]);
+      dstat = roots[i].stats;
+      recSummary(directories[i], &dstat);
+    } else if ((flags & F_TOPK) && !(flags & F_SUMMARY)) {
+      finishTree(&roots[i]);
+      dstat = roots[i].stats;
+    } else {
+      if (flags & F_SUMMARY) {
+        printf("Name                                                        User:Group           Size    Blocks Type\n");
+        printf("----------------------------------------------------------------------------------------------------\n");
+      }
+      printf("%s\n", directories[i]);
+      finishTree(&roots[i]);
+      dstat = roots[i].stats;
+      if (flags & F_SUMMARY) {
+        char *summary, *files, *dirs, *links, *fifos, *socks;
+        // summary line taking care to output grammatically correct English (singular and plural)
+        if (asprintf(&files, (dstat.files == 1) ? "%d file" : "%d files", dstat.files) == -1) panic("OUT OF MEMORY!");
+        if (asprintf(&dirs, (dstat.dirs == 1) ? "%d directory" : "%d directories", dstat.dirs) == -1) panic("OUT OF MEMORY!");
+        if (asprintf(&links, (dstat.links == 1) ? "%d link" : "%d links", dstat.links) == -1) panic("OUT OF MEMORY!");
+        if (asprintf(&fifos, (dstat.fifos == 1) ? "%d pipe" : "%d pipes", dstat.fifos) == -1) panic("OUT OF MEMORY!");
+        if (asprintf(&socks, (dstat.socks == 1) ? "%d socket" : "%d sockets", dstat.socks) == -1) panic("OUT OF MEMORY!");
+        if (asprintf(&summary, "%s, %s, %s, %s, and %s", files, dirs, links, fifos, socks) == -1) panic("OUT OF MEMORY!");
+        printf("----------------------------------------------------------------------------------------------------\n");
+        if (flags & F_VERBOSE) {
+          printf("%-68s   %14lld %9lld\n\n", summary, dstat.size, dstat.blocks);
+        } else {
+          printf("%s\n\n", summary);
+        }
+        free(summary); free(files); free(dirs); free(links); free(fifos); free(socks);
+      }
+    }
+
     // sum it up from every dstats
     tstat.files  += dstat.files;
     tstat.dirs   += dstat.dirs;
@@ -329,7 +2161,7 @@ int main(int argc, char *argv[])
   //
   // print grand total
   //
-  if ((flags & F_SUMMARY) && (ndir > 1)) {
+  if ((flags & F_SUMMARY) && !(flags & F_RECORDS) && (ndir > 1)) {
     printf("Analyzed %d directories:\n"
            "  total # of files:        %16d\n"
            "  total # of directories:  %16d\n"
@@ -345,6 +2177,25 @@ int main(int argc, char *argv[])
     }
   }
 
+  if (cachefn) cacheSave(cachefn);
+  if (flags & F_TOPK) printTopk();
+
+  //
+  // shut down worker threads
+  //
+  if (parallel) {
+    pthread_mutex_lock(&pool_lock);
+    pool_shutdown = 1;
+    pthread_cond_broadcast(&pool_cv);
+    pthread_mutex_unlock(&pool_lock);
+    for (unsigned int i = 0; i < nworkers; i++) pthread_join(workers[i].thread, NULL);
+  }
+
+  for (int i = 0; i < ndir; i++) pthread_mutex_destroy(&roots[i].lock);
+  free(roots);
+  for (int i = 0; i < ndir; i++) free((char*)directories[i]);
+  free(directories);
+
   //
   // that's all, folks
   //
@@ -0,0 +1,82 @@
+#!/bin/bash
+#---------------------------------------------------------------------------------------------------
+# System Programming                         I/O Lab                                    Fall 2021
+#
+# script to benchmark dirtree on large generated directory trees
+#
+# Usage: bash benchtree.sh [entries...]
+#
+# For each number of entries (default: 100000 1000000), a tree spec with FANOUT entries per
+# directory is written and turned into the directory tree bench<entries> with gentree (built by
+# make). The tree is kept and reused by later runs. dirtree is then run RUNS times and the wall
+# time and, if strace is installed, the number of system calls (total and getdents64) are reported.
+#
+# Environment variables:
+#   DIRTREE   dirtree binary (default: ../dirtree)
+#   GENTREE   tree generator binary (default: ./gentree)
+#   OPTS      dirtree options (default: -s)
+#   FANOUT    entries per directory (default: 100)
+#   RUNS      number of timed runs (default: 3)
+#
+
+TOOLS=${0%/*}
+DIRTREE=${DIRTREE:-$TOOLS/../dirtree}
+GENTREE=${GENTREE:-$TOOLS/gentree}
+OPTS=${OPTS:--s}
+FANOUT=${FANOUT:-100}
+RUNS=${RUNS:-3}
+SIZES=${@:-100000 1000000}
+
+if [[ ! -x $DIRTREE ]]; then
+  echo "Cannot execute '$DIRTREE'."
+  exit 1
+fi
+if [[ ! -x $GENTREE ]]; then
+  echo "Cannot execute '$GENTREE'. Run make first."
+  exit 1
+fi
+DIRTREE=`realpath $DIRTREE`
+GENTREE=`realpath $GENTREE`
+
+STRACE=`which strace 2>/dev/null`
+[[ -z "$STRACE" ]] && echo "strace not found, not counting system calls."
+
+cd $TOOLS
+
+printf "%10s  %-20s  %10s  %10s  %10s\n" "entries" "options" "wall [s]" "syscalls" "getdents"
+for N in $SIZES; do
+  TREE=bench$N
+
+  if [[ ! -d $TREE ]]; then
+    # file i lives in directory i/FANOUT, whose path are the base-FANOUT digits of i/FANOUT
+    awk -v n=$N -v f=$FANOUT -v root=./$TREE 'BEGIN {
+      for (i = 0; i < n; i++) {
+        p = ""
+        for (d = int(i / f); d > 0; d = int(d / f)) p = p "/d" (d % f)
+        printf "f %s%s/f%d 0 0\n", root, p, i % f
+      }
+    }' > $TREE.tree
+    $GENTREE $TREE.tree > /dev/null
+  fi
+
+  # warm up the page cache
+  $DIRTREE $OPTS $TREE > /dev/null
+
+  TIMEFORMAT=%R
+  for ((r = 0; r < $RUNS; r++)); do
+    WALL=$( { time $DIRTREE $OPTS $TREE > /dev/null; } 2>&1 )
+
+    CALLS="-"
+    GETDENTS="-"
+    if [[ -n "$STRACE" ]]; then
+      $STRACE -f -c -o $TREE.strace $DIRTREE $OPTS $TREE > /dev/null
+      CALLS=`awk '$NF == "total" { print $4 }' $TREE.strace`
+      GETDENTS=`awk '$NF == "getdents64" { print $4 }' $TREE.strace`
+      rm -f $TREE.strace
+    fi
+
+    printf "%10d  %-20s  %10s  %10s  %10s\n" $N "$OPTS" $WALL $CALLS ${GETDENTS:-0}
+  done
+done
+
+exit 0
@@ -0,0 +1,634 @@
+//--------------------------------------------------------------------------------------------------
+// System Programming                         I/O Lab                                    Fall 2021
+//
+/// @file
+/// @brief generate directory trees for testing and benchmarking
+/// @author agent <agent@local>
+//--------------------------------------------------------------------------------------------------
+
+// Tree generator
+// ==============
+// Usage: gentree [-j N] [-S] [file.tree]
+//        gentree [-j N] [-S] -g ROOT [-F fanout] [-D depth] [-n entries] [-s dist] [-m L,P,S]
+//                [-r seed]
+//
+// The first form reads the same .tree spec as gentree.sh (default: test1.tree next to the
+// binary) and creates the same tree:
+//   f <path> <size> <skip>   regular file with <size> zero bytes after a hole of <skip> bytes
+//   l <path> <target>        relative symbolic link to <target> (like 'ln -srf')
+//   p <path>                 named pipe
+//   s <path>                 unix socket
+//
+// The second form generates a synthetic tree below ROOT: every directory down to <depth> levels
+// contains <fanout> subdirectories (d0, d1, ...) and <entries> other entries. An entry is a
+// symbolic link (l<i> -> f0), named pipe (p<i>) or socket (s<i>) with the percentages given by
+// -m, and a regular file (f<i>) otherwise. File sizes follow the distribution <dist>:
+//   N                 all files have N bytes
+//   uniform:MIN:MAX   uniformly distributed between MIN and MAX bytes
+//   exp:MEAN          exponentially distributed with mean MEAN bytes
+// Sizes accept the suffixes K, M, and G. The sizes and types are derived from <seed> and the
+// position of the entry, so a tree is the same for any number of threads.
+//
+// With -S, files are created sparse: their size is set with ftruncate() and no data is written.
+//
+// Entries are created by N threads (default: number of CPUs) with openat(), mkfifoat() and
+// symlinkat() relative to a descriptor of their directory that each thread keeps open while
+// consecutive entries are in the same directory; missing directories are created on demand.
+// Links of a spec are created last, in order and by one thread: like 'ln -sr', the target is
+// canonicalized, so a link to a link resolves to the final target if it already exists.
+//
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define MAX_THREADS 256       ///< maximum number of threads (-j)
+#define CHUNK       64        ///< number of spec lines a thread takes at a time
+#define ZERO_BUF    65536     ///< size of the buffer of zeros written to files
+
+/// @brief file size distributions
+enum dist { D_FIXED, D_UNIFORM, D_EXP };
+
+/// @brief a line of a .tree spec
+struct line {
+  char type;                  ///< 'f', 'l', 'p', or 's'
+  char *path;                 ///< path of the entry
+  char *target;               ///< link target ('l')
+  unsigned long long size;    ///< file size ('f')
+  unsigned long long skip;    ///< leading hole ('f')
+};
+
+/// @brief directory descriptor kept open by a thread
+struct dcache {
+  char *path;                 ///< path of the directory
+  int fd;                     ///< descriptor, -1 if none
+};
+
+static struct line *lines;                                   ///< lines of the spec
+static size_t nlines;                                        ///< number of lines
+static size_t next;                                          ///< next line/directory to create
+
+static int sparse;                                           ///< create sparse files (-S)
+static const char *root;                                     ///< root of the synthetic tree (-g)
+static unsigned int fanout = 10, depth = 3, entries = 10;    ///< shape of the synthetic tree
+static unsigned int pct_link, pct_fifo, pct_sock;            ///< entry type mix (-m)
+static enum dist dist = D_FIXED;                             ///< file size distribution
+static unsigned long long dmin, dmax;                        ///< distribution parameters
+static uint64_t seed = 1;                                    ///< random seed (-r)
+static unsigned long long ndirs;                             ///< number of directories (-g)
+
+static unsigned long files, links, fifos, socks, errors;     ///< statistics (atomic)
+
+static const char zeros[ZERO_BUF];                           ///< data of regular files
+
+
+/// @brief splitmix64 pseudo-random number generator step
+static uint64_t mix(uint64_t x)
+{
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+
+/// @brief parse a size with an optional K, M, or G suffix
+///
+/// @param s string
+/// @param[out] v size
+/// @retval 0 on success
+/// @retval -1 if @a s is not a valid size
+static int parseSize(const char *s, unsigned long long *v)
+{
+  char *end;
+  errno = 0;
+  *v = strtoull(s, &end, 10);
+  if ((end == s) || (errno != 0)) return -1;
+
+  switch (*end) {
+    case 'G': *v <<= 10; /* fall through */
+    case 'M': *v <<= 10; /* fall through */
+    case 'K': *v <<= 10; end++; break;
+  }
+  return (*end == '\0') ? 0 : -1;
+}
+
+
+/// @brief create directory @a path and all missing parents (like 'mkdir -p')
+static void mkpath(const char *path)
+{
+  char *p = strdup(path);
+  if (p == NULL) abort();
+
+  for (char *s = strchr(p + 1, '/'); ; s = strchr(s + 1, '/')) {
+    if (s) *s = '\0';
+    if ((mkdir(p, 0777) != 0) && (errno != EEXIST)) break;
+    if (s == NULL) break;
+    *s = '/';
+  }
+
+  free(p);
+}
+
+
+/// @brief return a descriptor of directory @a dir, creating it if necessary. The descriptor is
+///        cached in @a dc and stays valid until the next call.
+///
+/// @retval >=0 descriptor
+/// @retval -1 on error
+static int dirFd(struct dcache *dc, const char *dir, size_t len)
+{
+  if ((dc->fd >= 0) && (strlen(dc->path) == len) && (strncmp(dc->path, dir, len) == 0)) return dc->fd;
+
+  if (dc->fd >= 0) close(dc->fd);
+  free(dc->path);
+  if ((dc->path = strndup(dir, len)) == NULL) abort();
+
+  dc->fd = open(dc->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if ((dc->fd < 0) && (errno == ENOENT)) {
+    mkpath(dc->path);
+    dc->fd = open(dc->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  }
+  return dc->fd;
+}
+
+
+/// @brief create a regular file @a name in directory @a dfd with @a size zero bytes after a hole
+///        of @a skip bytes
+///
+/// @retval 0 on success
+/// @retval -1 on error
+static int mkfileat(int dfd, const char *name, unsigned long long size, unsigned long long skip)
+{
+  int fd = openat(dfd, name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+  if (fd < 0) return -1;
+
+  int res = 0;
+  if (sparse) {
+    res = ftruncate(fd, skip + size);
+  } else {
+    if (skip > 0) res = ftruncate(fd, skip);
+    for (unsigned long long off = 0; (res == 0) && (off < size); ) {
+      size_t n = (size - off < ZERO_BUF) ? size - off : ZERO_BUF;
+      ssize_t w = pwrite(fd, zeros, n, skip + off);
+      if (w <= 0) res = -1;
+      else off += w;
+    }
+  }
+
+  if (close(fd) != 0) res = -1;
+  return res;
+}
+
+
+/// @brief create a unix socket @a name in directory @a dfd
+///
+/// @retval 0 on success
+/// @retval -1 on error
+static int mksockat(int dfd, const char *name)
+{
+  // bind() has no *at variant: address the directory through its descriptor
+  struct sockaddr_un addr = { .sun_family = AF_UNIX };
+  if (snprintf(addr.sun_path, sizeof(addr.sun_path), "/proc/self/fd/%d/%s", dfd, name) >=
+      (int)sizeof(addr.sun_path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  int s = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (s < 0) return -1;
+
+  unlinkat(dfd, name, 0);
+  int res = bind(s, (struct sockaddr*)&addr, sizeof(addr));
+  close(s);
+  return res;
+}
+
+
+/// @brief canonicalize @a path like 'realpath -m': symbolic links are resolved as far as the path
+///        exists, missing components are appended literally
+///
+/// @retval char* absolute path (must be freed)
+static char* canonical(const char *path)
+{
+  char *r = realpath(path, NULL);
+  if (r != NULL) return r;
+
+  char *slash = strrchr(path, '/');
+  char *dir = slash ? ((slash == path) ? strdup("/") : strndup(path, slash - path)) : strdup(".");
+  if (dir == NULL) abort();
+
+  char *d = canonical(dir);
+  const char *base = slash ? slash + 1 : path;
+  if (asprintf(&r, "%s%s%s", d, strcmp(d, "/") ? "/" : "", base) == -1) abort();
+
+  free(dir);
+  free(d);
+  return r;
+}
+
+
+/// @brief compute the path of @a to relative to directory @a from (both absolute and canonical)
+///
+/// @retval char* relative path (must be freed)
+static char* relative(const char *from, const char *to)
+{
+  // find the longest common prefix that ends at a component boundary of both paths
+  size_t common = 0;
+  for (size_t i = 0; ; i++) {
+    if (((from[i] == '\0') || (from[i] == '/')) && ((to[i] == '\0') || (to[i] == '/'))) common = i;
+    if ((from[i] != to[i]) || (from[i] == '\0')) break;
+  }
+
+  // one '..' per remaining component of from
+  size_t up = 0;
+  for (const char *s = from + common; *s; s++) up += (s[0] == '/') && (s[1] != '\0');
+
+  const char *rest = to + common + (to[common] == '/');
+  char *r = malloc(3*up + strlen(rest) + 2);
+  if (r == NULL) abort();
+
+  char *p = r;
+  for (size_t u = 0; u < up; u++, p += 3) memcpy(p, "../", 3);
+  strcpy(p, rest);
+  if (*r == '\0') strcpy(r, ".");
+  else if ((p > r) && (*rest == '\0')) p[-1] = '\0';
+  return r;
+}
+
+
+/// @brief create the entry of spec line @a l
+///
+/// @param l line
+/// @param dc directory cache of the calling thread
+static void createLine(const struct line *l, struct dcache *dc)
+{
+  const char *slash = strrchr(l->path, '/');
+  const char *dir = slash ? l->path : ".", *name = slash ? slash + 1 : l->path;
+  size_t dlen = slash ? (size_t)(slash - l->path) : 1;
+  if (dlen == 0) dlen = 1;   // entry in '/'
+
+  int dfd = dirFd(dc, dir, dlen);
+  int res = -1;
+
+  switch (l->type) {
+    case 'f':
+      if ((dfd >= 0) && ((res = mkfileat(dfd, name, l->size, l->skip)) == 0)) __atomic_add_fetch(&files, 1, __ATOMIC_RELAXED);
+      else printf("  Failed to create file '%s'.\n", l->path);
+      break;
+
+    case 'l':
+      if (dfd >= 0) {
+        char *from = canonical(dc->path), *to = canonical(l->target), *rel = relative(from, to);
+        unlinkat(dfd, name, 0);
+        res = symlinkat(rel, dfd, name);
+        free(from);
+        free(to);
+        free(rel);
+      }
+      if (res == 0) __atomic_add_fetch(&links, 1, __ATOMIC_RELAXED);
+      else printf("  Failed to create link '%s'.\n", l->path);
+      break;
+
+    case 'p':
+      if ((dfd >= 0) && ((res = mkfifoat(dfd, name, 0666)) == 0)) __atomic_add_fetch(&fifos, 1, __ATOMIC_RELAXED);
+      else printf("  Failed to create named pipe '%s'.\n", l->path);
+      break;
+
+    case 's':
+      if ((dfd >= 0) && ((res = mksockat(dfd, name)) == 0)) __atomic_add_fetch(&socks, 1, __ATOMIC_RELAXED);
+      else printf("  Failed to create unix socket '%s'.\n", l->path);
+      break;
+  }
+
+  if (res != 0) __atomic_add_fetch(&errors, 1, __ATOMIC_RELAXED);
+}
+
+
+/// @brief read the spec @a fn into @a lines. Links are moved to the end, keeping their order.
+static void readSpec(const char *fn)
+{
+  FILE *f = fopen(fn, "r");
+  if (f == NULL) {
+    printf("Cannot read from input file '%s'.\n", fn);
+    exit(EXIT_FAILURE);
+  }
+
+  size_t cap = 0;
+  char *buf = NULL;
+  size_t bufsize = 0;
+  while (getline(&buf, &bufsize, f) != -1) {
+    char *save, *tok[5], *orig;
+    int n = 0;
+
+    // ignore comments and blank lines
+    char *s = buf + strspn(buf, " \t");
+    if (*s == '#') continue;
+    if ((orig = strndup(s, strcspn(s, "\r\n"))) == NULL) abort();
+    for (char *t = strtok_r(s, " \t\r\n", &save); t && (n < 5); t = strtok_r(NULL, " \t\r\n", &save)) tok[n++] = t;
+    if (n == 0) continue;
+
+    struct line l = { 0 };
+    l.type = (tok[0][1] == '\0') ? tok[0][0] | 0x20 : '?';
+    int valid;
+    switch (l.type) {
+      case 'f': valid = (n == 4) && !parseSize(tok[2], &l.size) && !parseSize(tok[3], &l.skip); break;
+      case 'l': valid = (n == 3); break;
+      case 'p':
+      case 's': valid = (n == 2); break;
+      default: valid = 0;
+    }
+    if (!valid) {
+      printf("  Ignoring invalid line: '%s'.\n", orig);
+      errors++;
+    }
+    free(orig);
+    if (!valid) continue;
+
+    if (((l.path = strdup(tok[1])) == NULL) || ((l.type == 'l') && ((l.target = strdup(tok[2])) == NULL))) abort();
+
+    if (nlines == cap) {
+      cap = cap ? 2*cap : 1024;
+      if ((lines = realloc(lines, cap * sizeof(struct line))) == NULL) abort();
+    }
+    lines[nlines++] = l;
+  }
+  free(buf);
+  fclose(f);
+
+  // stable partition: links last
+  struct line *tmp = malloc(nlines * sizeof(struct line));
+  if ((tmp == NULL) && (nlines > 0)) abort();
+  size_t k = 0;
+  for (size_t i = 0; i < nlines; i++) if (lines[i].type != 'l') tmp[k++] = lines[i];
+  for (size_t i = 0; i < nlines; i++) if (lines[i].type == 'l') tmp[k++] = lines[i];
+  free(lines);
+  lines = tmp;
+}
+
+
+/// @brief thread: create the non-link entries of the spec, CHUNK lines at a time
+static void* specWorker(void *arg)
+{
+  size_t end = *(size_t*)arg;
+  struct dcache dc = { NULL, -1 };
+
+  while (1) {
+    size_t i = __atomic_fetch_add(&next, CHUNK, __ATOMIC_RELAXED);
+    if (i >= end) break;
+    for (size_t e = (i + CHUNK < end) ? i + CHUNK : end; i < e; i++) createLine(&lines[i], &dc);
+  }
+
+  if (dc.fd >= 0) close(dc.fd);
+  free(dc.path);
+  return NULL;
+}
+
+
+/// @brief size of the file with random value @a r according to the size distribution
+static unsigned long long fileSize(uint64_t r)
+{
+  switch (dist) {
+    case D_UNIFORM: return dmin + r % (dmax - dmin + 1);
+    case D_EXP:     return (unsigned long long)(-(double)dmin * log(((r >> 11) + 0.5) / 9007199254740992.0));
+    default:        return dmin;
+  }
+}
+
+
+/// @brief thread: create the directories of the synthetic tree (in breadth-first order) and
+///        their entries
+static void* synthWorker(void *arg)
+{
+  (void)arg;
+  size_t plen = strlen(root);
+  char *path = malloc(plen + 12*(depth + 1) + 1);
+  if (path == NULL) abort();
+  memcpy(path, root, plen);
+
+  while (1) {
+    unsigned long long k = __atomic_fetch_add(&next, 1, __ATOMIC_RELAXED);
+    if (k >= ndirs) break;
+
+    // level and position of directory k; its path are the base-fanout digits of the position
+    unsigned int level = 0;
+    unsigned long long pos = k, width = 1;
+    while (pos >= width) {
+      pos -= width;
+      width *= fanout;
+      level++;
+    }
+    size_t len = plen;
+    unsigned int digit[64];
+    for (unsigned int d = level; d > 0; d--, pos /= fanout) digit[d-1] = pos % fanout;
+    for (unsigned int d = 0; d < level; d++) len += sprintf(path + len, "/d%u", digit[d]);
+
+    struct dcache dc = { NULL, -1 };
+    int dfd = dirFd(&dc, path, len);
+    if (dfd < 0) {
+      printf("  Failed to create directory '%s'.\n", dc.path);
+      __atomic_add_fetch(&errors, 1, __ATOMIC_RELAXED);
+      free(dc.path);
+      continue;
+    }
+
+    // leaves have no subdirectories; create them here so that empty directories exist, too
+    if (level < depth) {
+      for (unsigned int i = 0; i < fanout; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "d%u", i);
+        if ((mkdirat(dfd, name, 0777) != 0) && (errno != EEXIST)) __atomic_add_fetch(&errors, 1, __ATOMIC_RELAXED);
+      }
+    }
+
+    for (unsigned int i = 0; i < entries; i++) {
+      uint64_t r = mix(seed ^ mix(k * entries + i));
+      unsigned int t = r % 100;
+      char name[16];
+      int res;
+
+      if (t < pct_link) {
+        snprintf(name, sizeof(name), "l%u", i);
+        unlinkat(dfd, name, 0);
+        if ((res = symlinkat("f0", dfd, name)) == 0) __atomic_add_fetch(&links, 1, __ATOMIC_RELAXED);
+      } else if (t < pct_link + pct_fifo) {
+        snprintf(name, sizeof(name), "p%u", i);
+        if ((res = mkfifoat(dfd, name, 0666)) == 0) __atomic_add_fetch(&fifos, 1, __ATOMIC_RELAXED);
+      } else if (t < pct_link + pct_fifo + pct_sock) {
+        snprintf(name, sizeof(name), "s%u", i);
+        if ((res = mksockat(dfd, name)) == 0) __atomic_add_fetch(&socks, 1, __ATOMIC_RELAXED);
+      } else {
+        snprintf(name, sizeof(name), "f%u", i);
+        if ((res = mkfileat(dfd, name, fileSize(mix(r)), 0)) == 0) __atomic_add_fetch(&files, 1, __ATOMIC_RELAXED);
+      }
+
+      if (res != 0) {
+        printf("  Failed to create '%s/%s': %s.\n", dc.path, name, strerror(errno));
+        __atomic_add_fetch(&errors, 1, __ATOMIC_RELAXED);
+      }
+    }
+
+    close(dc.fd);
+    free(dc.path);
+  }
+
+  free(path);
+  return NULL;
+}
+
+
+/// @brief print program syntax and an optional error message. Aborts the program with EXIT_FAILURE
+static void syntax(const char *argv0, const char *error, const char *arg)
+{
+  if (error) fprintf(stderr, "%s%s\n\n", error, arg ? arg : "");
+
+  fprintf(stderr, "Usage %s [-j N] [-S] [file.tree]\n"
+                  "      %s [-j N] [-S] -g ROOT [-F fanout] [-D depth] [-n entries] [-s dist]\n"
+                  "                [-m L,P,S] [-r seed]\n"
+                  "Generate a directory tree from a .tree spec (default: test1.tree) or a synthetic tree.\n"
+                  "\n"
+                  "Options:\n"
+                  " -j N      create entries with N threads (default: number of CPUs)\n"
+                  " -S        create sparse files\n"
+                  " -g ROOT   generate a synthetic tree below ROOT\n"
+                  " -F N      subdirectories per directory (default 10)\n"
+                  " -D N      depth of the tree (default 3)\n"
+                  " -n N      entries other than subdirectories per directory (default 10)\n"
+                  " -s DIST   file sizes: N, uniform:MIN:MAX, or exp:MEAN (default 0)\n"
+                  " -m L,P,S  percentage of links, named pipes, and sockets among the entries\n"
+                  " -r N      random seed (default 1)\n"
+                  " -h        print this help\n",
+                  argv0, argv0);
+  exit(EXIT_FAILURE);
+}
+
+
+/// @brief parse an unsigned number argument
+static unsigned int number(const char *argv0, const char *s, unsigned int min, unsigned int max)
+{
+  char *end;
+  unsigned long v = strtoul(s, &end, 10);
+  if ((*s == '\0') || (*end != '\0') || (v < min) || (v > max)) syntax(argv0, "Invalid number: ", s);
+  return v;
+}
+
+
+/// @brief program entry point
+int main(int argc, char *argv[])
+{
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  unsigned int nthreads = (ncpu < 1) ? 1 : (ncpu > MAX_THREADS) ? MAX_THREADS : ncpu;
+  char *input = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    if ((a[0] != '-') || (a[1] == '\0')) {
+      input = argv[i];
+      continue;
+    }
+    if (!strcmp(a, "-S")) { sparse = 1; continue; }
+    if (!strcmp(a, "-h")) syntax(argv[0], NULL, NULL);
+    if ((a[2] != '\0') || strchr("jgFDnsmr", a[1]) == NULL) syntax(argv[0], "Unrecognized option: ", a);
+    if (++i == argc) syntax(argv[0], "Missing argument to ", a);
+
+    switch (a[1]) {
+      case 'j': nthreads = number(argv[0], argv[i], 1, MAX_THREADS); break;
+      case 'g': root = argv[i]; break;
+      case 'F': fanout = number(argv[0], argv[i], 1, 1000000); break;
+      case 'D': depth = number(argv[0], argv[i], 0, 64); break;
+      case 'n': entries = number(argv[0], argv[i], 0, 100000000); break;
+      case 'r': seed = strtoull(argv[i], NULL, 0); break;
+      case 'm':
+        if ((sscanf(argv[i], "%u,%u,%u", &pct_link, &pct_fifo, &pct_sock) != 3) ||
+            (pct_link + pct_fifo + pct_sock > 100)) syntax(argv[0], "Invalid entry mix: ", argv[i]);
+        break;
+      case 's': {
+        char *p = strchr(argv[i], ':'), *q = p ? strchr(p + 1, ':') : NULL;
+        int ok;
+        if (!strncmp(argv[i], "uniform:", 8) && q) {
+          *q = '\0';
+          ok = !parseSize(p + 1, &dmin) && !parseSize(q + 1, &dmax) && (dmin <= dmax);
+          dist = D_UNIFORM;
+        } else if (!strncmp(argv[i], "exp:", 4)) {
+          ok = !parseSize(p + 1, &dmin);
+          dist = D_EXP;
+        } else {
+          ok = !parseSize(argv[i], &dmin);
+          dist = D_FIXED;
+        }
+        if (!ok) syntax(argv[0], "Invalid size distribution: ", argv[i]);
+        break;
+      }
+    }
+  }
+
+  pthread_t thread[MAX_THREADS];
+  size_t end = 0;
+  void *(*worker)(void*);
+
+  if (root) {
+    // number of directories: 1 + fanout + ... + fanout^depth
+    unsigned long long width = 1;
+    for (unsigned int d = 0; d <= depth; d++) {
+      ndirs += width;
+      if ((ndirs > 1000000000ull) || ((d < depth) && (width > 1000000000ull / fanout))) {
+        syntax(argv[0], "Tree too large.", NULL);
+      }
+      width *= fanout;
+    }
+    printf("Generating synthetic tree '%s' (%llu directories)...\n", root, ndirs);
+    mkpath(root);
+    worker = synthWorker;
+  } else {
+    char *def = NULL;
+    if (input == NULL) {
+      const char *slash = strrchr(argv[0], '/');
+      if (asprintf(&def, "%.*stest1.tree", slash ? (int)(slash - argv[0] + 1) : 0, argv[0]) == -1) abort();
+      input = def;
+    }
+    printf("Generating tree from '%s'...\n", input);
+    readSpec(input);
+    free(def);
+
+    // files, fifos, and sockets in parallel, links afterwards
+    while ((end < nlines) && (lines[end].type != 'l')) end++;
+    worker = specWorker;
+  }
+
+  unsigned int started = 0;
+  for (; started < nthreads; started++) {
+    if (pthread_create(&thread[started], NULL, worker, &end) != 0) break;
+  }
+  if (started == 0) worker(&end);
+  for (unsigned int i = 0; i < started; i++) pthread_join(thread[i], NULL);
+
+  if (!root) {
+    struct dcache dc = { NULL, -1 };
+    for (size_t i = end; i < nlines; i++) createLine(&lines[i], &dc);
+    if (dc.fd >= 0) close(dc.fd);
+    free(dc.path);
+
+    for (size_t i = 0; i < nlines; i++) {
+      free(lines[i].path);
+      free(lines[i].target);
+    }
+    free(lines);
+  }
+
+  printf("Done. Generated %lu files, %lu links, %lu fifos, and %lu sockets. %lu errors reported.\n",
+         files, links, fifos, socks, errors);
+
+  return EXIT_SUCCESS;
+}
@@ -69,6 +69,12 @@
 // ds_release() releases all memory and resets all internal variables. A subsequent call to
 // ds_allocate() is supported and initializes a 'fresh' heap.
 //
+// Fault injection:
+// ----------------
+// To test the allocator under memory pressure, ds_setfault() makes ds_sbrk() fail with ENOMEM
+// on the n-th subsequent call that grows the heap and/or randomly with a given probability.
+// Calls that shrink the heap never fail. ds_getnfault() returns the number of injected faults.
+//
 
 #include <assert.h>
 #include <errno.h>
@@ -93,6 +99,10 @@ static int  ds_loglevel    = 0;     ///< log level (0: off; 1: info; 2: verbose)
 static int  ds_domprotect  = 1;     ///< mprotect() heap areas (0: off, 1: on)
 static ssize_t ds_num_sbrk = 0;     ///< number of times ds_sbrk() was called with a non-zero 
                                     ///< argument
+static ssize_t ds_fault_nth = 0;    ///< fail the n-th growing ds_sbrk() call (0: off)
+static double  ds_fault_rate = 0.0; ///< probability of failing a growing ds_sbrk() call
+static unsigned int ds_fault_seed = 0; ///< random number generator state for fault injection
+static ssize_t ds_num_fault = 0;    ///< number of injected faults
 
 
 /// @brief print a log message if level <= ds_loglevel. The variadic argument is a printf format
@@ -122,6 +132,19 @@ static void ds_log(int level, ...)
   #define LOG(level, ...)
 #endif
 
+/// @brief decide whether the current growing ds_sbrk() call fails
+/// @retval 1 if a fault is to be injected
+/// @retval 0 otherwise
+static int ds_inject_fault(void)
+{
+  if ((ds_fault_nth > 0) && (--ds_fault_nth == 0)) return 1;
+  if ((ds_fault_rate > 0.0) && (rand_r(&ds_fault_seed) < ds_fault_rate * ((double)RAND_MAX + 1))) {
+    return 1;
+  }
+
+  return 0;
+}
+
 void ds_allocate(size_t max_heap_size)
 {
   LOG(1, "ds_allocate(%lx)", max_heap_size);
@@ -190,6 +213,13 @@ void* ds_sbrk(intptr_t increment)
 
   void *old_heap_brk = ds_heap_brk;
 
+  if ((increment > 0) && ds_inject_fault()) {
+    LOG(1, "  injected fault");
+    ds_num_fault++;
+    errno = ENOMEM;
+    return (void*)-1;
+  }
+
   if (increment != 0) {
     ds_heap_brk += increment;
     ds_num_sbrk++;
@@ -261,3 +291,38 @@ void ds_setmprotect(int active)
 }
 
 
+void ds_setfault(ssize_t nth, double rate, unsigned int seed)
+{
+  ds_fault_nth  = nth > 0 ? nth : 0;
+  ds_fault_rate = rate;
+  ds_fault_seed = seed;
+  ds_num_fault  = 0;
+}
+
+
+ssize_t ds_getnfault(void)
+{
+  return ds_num_fault;
+}
+
+
+size_t ds_getresident(void)
+{
+  assert(ds_initialized);
+
+  size_t len = ds_heap_brk - ds_heap_start;
+  size_t npages = (len + PAGESIZE - 1) / PAGESIZE;
+  if (npages == 0) return 0;
+
+  unsigned char *vec = malloc(npages);
+  if ((vec == NULL) || (mincore(ds_heap_start, len, vec) != 0)) {
+    free(vec);
+    return 0;
+  }
+
+  size_t resident = 0;
+  for (size_t i = 0; i < npages; i++) if (vec[i] & 1) resident++;
+  free(vec);
+
+  return resident * PAGESIZE;
+}
@@ -67,6 +67,10 @@ void ds_heap_stat(void **start, void **brk, void **end);
 /// @retval ssize_t number of sbrk() calls
 ssize_t ds_getnsbrk(void);
 
+/// @brief retrieve the number of bytes of the heap area (start to brk) that are resident in RAM
+/// @retval size_t resident bytes (0 on error)
+size_t ds_getresident(void);
+
 /// @brief set log level
 /// @brief level log level (0: no logging, 1: info; 2: verbose)
 void ds_setloglevel(int level);
@@ -75,4 +79,14 @@ void ds_setloglevel(int level);
 /// @brief active (1: mprotect() activated, 0: mprotect() not executed)
 void ds_setmprotect(int active);
 
+/// @brief inject ds_sbrk() failures. Only calls that grow the heap fail (with ENOMEM).
+/// @param nth fail the @a nth subsequent call that grows the heap (0: off)
+/// @param rate probability with which each call that grows the heap fails (0.0: off)
+/// @param seed seed for the random fault injection
+void ds_setfault(ssize_t nth, double rate, unsigned int seed);
+
+/// @brief retrieve the number of injected ds_sbrk() failures since the last ds_setfault()
+/// @retval ssize_t number of injected faults
+ssize_t ds_getnfault(void);
+
 #endif // __DATSEG_H__
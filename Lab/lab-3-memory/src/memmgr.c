@@ -37,8 +37,47 @@
 //                       |                                         |
 //               32-byte aligned                           32-byte aligned
 //
+// Explicit free list:
+// -------------------
+// In addition to the implicit list formed by the boundary tags, all free blocks are kept in a
+// circular doubly-linked list. The first two payload words of a free block hold the pointers to
+// the next and previous free block in the list:
+//
+//               +---+------+------+-----------------------------------+---+
+//               | h | next | prev |                                   | f |
+//               +---+------+------+-----------------------------------+---+
+//
+// The list is not ordered; blocks are inserted in front of the rover (next_block). Next fit
+// walks the list starting at the rover, so a search never touches allocated blocks and is
+// bounded by the number of free blocks. Whenever the block the rover points to is removed from
+// the list, the rover advances to its successor.
+//
+// Purging:
+// --------
+// Only the last block can be returned to the data segment with ds_sbrk(). To reduce the resident
+// set size, the physical pages inside free blocks that are at least purge_threshold bytes large
+// are released with madvise(MADV_DONTNEED). The heap layout is not changed. The kernel provides
+// zero-filled pages on the next access, hence purged blocks are marked with the PURGED flag in
+// their boundary tags so that mm_calloc() can skip clearing these pages. The flag guarantees
+// that the pages in the block's purge range (see below) have not been touched since.
+//
+// Purging is deferred: mm_free() counts the freed bytes and runs a purge pass over the free list
+// once PURGE_RATIO * purge_threshold bytes have been freed since the last pass. A pass marks
+// large free blocks with the SEEN flag and purges those that are still marked, i.e., that have
+// not been modified since the previous pass. Blocks that are reused quickly are thus never
+// purged, and blocks that are purged already are skipped.
+// Splitting a purged block keeps the flag on the remainder, whose range is a part of the
+// original range. A block coalesced with purged neighbors stays purged if their ranges cover its
+// range. The last block is not purged unless it is larger than what mm_free() leaves after
+// shrinking the heap: it is where the heap grows and shrinks.
+//
+//               +---+------+------+---------+===========================+---------+---+
+//               | h | next | prev |         |  purged (page-aligned)    |         | f |
+//               +---+------+------+---------+===========================+---------+---+
+//
 // - allocation policies: first, next, best fit
-// - block splitting: always at 32-byte boundaries
+// - block splitting: always at 32-byte boundaries, except for the leading free fragment split off
+//   by mm_memalign(). Block sizes are thus a multiple of the word size, but at least 32 bytes.
 // - immediate coalescing upon free
 //
 
@@ -50,6 +89,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <math.h>
 
@@ -64,7 +104,12 @@ static void *ds_heap_start = NULL;                     ///< physical start of da
 static void *ds_heap_brk   = NULL;                     ///< physical end of data segment
 static void *heap_start    = NULL;                     ///< logical start of heap
 static void *heap_end      = NULL;                     ///< logical end of heap
-static void *next_block    = NULL;
+static void *next_block    = NULL;                     ///< rover into the free list (next fit)
+static size_t nsearch      = 0;                        ///< number of free block searches
+static size_t ntries       = 0;                        ///< number of blocks inspected by searches
+static size_t purge_threshold = 64*1024;               ///< min. size of free blocks to purge (0: off)
+static size_t npurged      = 0;                        ///< number of bytes purged
+static size_t nfreed       = 0;                        ///< bytes freed since the last purge pass
 static int  PAGESIZE       = 0;                        ///< memory system page size
 static void *(*get_free_block)(size_t) = NULL;         ///< get free block for selected allocation policy
 static int  mm_initialized = 0;                        ///< initialized flag (yes: 1, otherwise 0)
@@ -80,7 +125,10 @@ static int  mm_loglevel    = 0;                        ///< log level (0: off; 1
 
 #define ALLOC              1                           ///< block allocated flag
 #define FREE               0                           ///< block free flag
+#define PURGED             2                           ///< free block purged flag
+#define SEEN               4                           ///< free block seen by last purge pass flag
 #define STATUS_MASK        ((TYPE)(0x7))               ///< mask to retrieve flagsfrom header/footer
+#define ALLOC_MASK         ((TYPE)(0x1))               ///< mask to retrieve status from header/footer
 #define SIZE_MASK          (~STATUS_MASK)              ///< mask to retrieve size from header/footer
 
 #define CHUNKSIZE          (1*(1 << 12))               ///< size by which heap is extended
@@ -95,11 +143,12 @@ static int  mm_loglevel    = 0;                        ///< log level (0: off; 1
 
 #define PACK(size,status)  ((size) | (status))         ///< pack size & status into boundary tag
 #define SIZE(v)            (v & SIZE_MASK)             ///< extract size from boundary tag
-#define STATUS(v)          (v & STATUS_MASK)           ///< extract status from boundary tag
+#define STATUS(v)          (v & ALLOC_MASK)            ///< extract status from boundary tag
 
 #define GET(p)             (*(TYPE*)(p))               ///< read word at *p
 #define GET_SIZE(p)        (SIZE(GET(p)))              ///< extract size from header/footer
 #define GET_STATUS(p)      (STATUS(GET(p)))            ///< extract status from header/footer
+#define IS_PURGED(p)       ((GET(p) & PURGED) != 0)    ///< check purged flag of free block p
 
 // TODO add more macros as needed
 #define PUT(p, v)          (*(TYPE*)(p) = (TYPE)(v))   ///< write data v at address p
@@ -107,6 +156,11 @@ static int  mm_loglevel    = 0;                        ///< log level (0: off; 1
 #define END(p)             (PREV_PTR(p+GET_SIZE(p)))   ///< get end pointer of the block whose start is p
 #define START(p)           (NEXT_PTR(p-GET_SIZE(p)))   ///< get start pointer of the block whose end is p
 #define INITCHUNK          (CHUNKSIZE << 4)            ///< initial chunk size
+#define PURGE_RATIO        16                          ///< purge pass every PURGE_RATIO*threshold freed bytes
+#define MAX_SIZE           ((size_t)1 << 48)           ///< largest supported request size
+
+#define NEXT_FREE(p)       (*(void**)NEXT_PTR(p))      ///< next block in free list of free block p
+#define PREV_FREE(p)       (*(void**)NEXT_PTR(NEXT_PTR(p))) ///< previous block in free list
 
 /// @brief print a log message if level <= mm_loglevel. The variadic argument is a printf format
 ///        string followed by its parametrs
@@ -166,6 +220,133 @@ static void mm_panic(const char *func, ...)
 /// @}
 
 
+/// @name Free list management
+/// @{
+
+/// @brief insert free block @a p into the free list in front of the rover
+/// @param p pointer to header of free block
+static void fl_insert(void *p)
+{
+  if (next_block == NULL) {
+    NEXT_FREE(p) = PREV_FREE(p) = p;
+    next_block = p;
+  } else {
+    void *prev = PREV_FREE(next_block);
+    NEXT_FREE(p) = next_block;
+    PREV_FREE(p) = prev;
+    NEXT_FREE(prev) = p;
+    PREV_FREE(next_block) = p;
+  }
+}
+
+/// @brief remove free block @a p from the free list. Advances the rover if it points to @a p.
+/// @param p pointer to header of free block
+static void fl_remove(void *p)
+{
+  if (NEXT_FREE(p) == p) {
+    next_block = NULL;
+  } else {
+    NEXT_FREE(PREV_FREE(p)) = NEXT_FREE(p);
+    PREV_FREE(NEXT_FREE(p)) = PREV_FREE(p);
+    if (next_block == p) next_block = NEXT_FREE(p);
+  }
+}
+
+/// @brief replace free block @a p by free block @a q at the same position in the free list
+/// @param p pointer to header of free block in list
+/// @param q pointer to header of free block not in list
+static void fl_replace(void *p, void *q)
+{
+  if (NEXT_FREE(p) == p) {
+    NEXT_FREE(q) = PREV_FREE(q) = q;
+  } else {
+    NEXT_FREE(q) = NEXT_FREE(p);
+    PREV_FREE(q) = PREV_FREE(p);
+    PREV_FREE(NEXT_FREE(q)) = q;
+    NEXT_FREE(PREV_FREE(q)) = q;
+  }
+  if (next_block == p) next_block = q;
+}
+
+/// @}
+
+
+/// @name Purging
+/// @{
+
+/// @brief compute the page-aligned range inside free block @a p that can be purged. The range
+///        excludes the header, the free list pointers, and the footer.
+/// @param p pointer to header of free block
+/// @param[out] from start of range
+/// @param[out] to end of range (from >= to if the range is empty)
+static void purge_range(void *p, void **from, void **to)
+{
+  TYPE pagemask = ~((TYPE)PAGESIZE - 1);
+
+  *from = PTR((WORD(p) + 3*TYPE_SIZE + PAGESIZE - 1) & pagemask);
+  *to   = PTR(WORD(END(p)) & pagemask);
+}
+
+/// @brief check whether free block @a p is large enough to be purged
+/// @param p pointer to header of free block
+/// @retval 1 if the block should be purged
+/// @retval 0 otherwise
+static int purgeable(void *p)
+{
+  size_t size = GET_SIZE(p);
+  if ((purge_threshold == 0) || (size < purge_threshold)) return 0;
+  if ((p + size == heap_end) && (size <= INITCHUNK + CHUNKSIZE)) return 0;
+
+  return 1;
+}
+
+/// @brief set the flags of free block @a p to @a flags
+/// @param p pointer to header of free block
+/// @param flags PURGED or SEEN
+static void set_flags(void *p, TYPE flags)
+{
+  TYPE bdrtag = PACK(GET_SIZE(p), FREE | flags);
+  PUT(p, bdrtag);
+  PUT(END(p), bdrtag);
+}
+
+/// @brief release the physical pages inside the free block @a p and mark the block as purged
+/// @param p pointer to header of free block
+static void purge_block(void *p)
+{
+  void *from, *to;
+  purge_range(p, &from, &to);
+
+  if (from < to) {
+    LOG(1, "purge(%p, 0x%lx)", from, to - from);
+    if (madvise(from, to - from, MADV_DONTNEED) != 0) return;
+    npurged += to - from;
+  }
+
+  set_flags(p, PURGED);
+}
+
+/// @brief purge the free blocks that are large enough and have not been modified since the last
+///        pass; mark the others as seen
+static void purge_pass(void)
+{
+  LOG(1, "purge_pass()");
+  nfreed = 0;
+  if (next_block == NULL) return;
+
+  void *p = next_block;
+  do {
+    if (!IS_PURGED(p) && purgeable(p)) {
+      if (GET(p) & SEEN) purge_block(p);
+      else set_flags(p, SEEN);
+    }
+    p = NEXT_FREE(p);
+  } while (p != next_block);
+}
+
+/// @}
+
+
 static void* ff_get_free_block(size_t);
 static void* nf_get_free_block(size_t);
 static void* bf_get_free_block(size_t);
@@ -204,14 +385,13 @@ void mm_init(AllocationPolicy ap)
   //
   // initialize heap
   //
-  ds_sbrk(INITCHUNK);
+  if (ds_sbrk(INITCHUNK) == (void*)-1) PANIC("Cannot extend heap.");
   ds_heap_brk = ds_sbrk(0);
   LOG(2, "  allocated memory, new ds_heap_brk is at %p", ds_heap_brk);
-  if (ds_heap_brk == (void*)-1) PANIC("Cannot extend heap.");
 
   heap_start = ds_heap_start;
   LOG(2, "  old heap_start is at %p", heap_start);
-  next_block = heap_start = (TYPE*)(((TYPE)heap_start + BS) / BS * BS);
+  heap_start = (TYPE*)(((TYPE)heap_start + BS) / BS * BS);
   LOG(2, "  new heap_start is at %p", heap_start);
   PUT(PREV_PTR(heap_start), PACK(0, ALLOC));
   
@@ -226,6 +406,10 @@ void mm_init(AllocationPolicy ap)
   PUT(heap_start, bdrtag);
   PUT(PREV_PTR(heap_end), bdrtag);
 
+  next_block = NULL;
+  fl_insert(heap_start);
+  nsearch = ntries = npurged = nfreed = 0;
+
   //
   // heap is initialized
   //
@@ -233,72 +417,123 @@ void mm_init(AllocationPolicy ap)
 }
 
 
-void* mm_malloc(size_t size)
+/// @brief extend the heap such that the last block is free and at least @a req_size bytes large
+/// @param req_size required size of the last block (including header & footer tags), in bytes
+/// @retval void* pointer to header of the (coalesced) last free block
+/// @retval NULL if the data segment cannot be extended. The heap is left unmodified.
+static void* expand_heap(size_t req_size)
 {
-  LOG(1, "mm_malloc(0x%lx (%ld))", size, size);
-
-  assert(mm_initialized);
-  size_t req_size = ceil((double)(size + 2*TYPE_SIZE) / BS) * BS;
-  
-  void *start_alloc = get_free_block(req_size);
-  if (start_alloc == NULL) {
-    LOG(1, "expand_heap(0x%lx (%ld))", req_size, req_size);
-    
-    void *p = heap_end;
-    size_t size = (GET_STATUS(PREV_PTR(p)) == FREE) ? GET_SIZE(PREV_PTR(p)) : 0;
-    LOG(2, "  last block");
-    LOG(2, "    header               %p", START(PREV_PTR(p)));
-    LOG(2, "    footer               %p", PREV_PTR(p));
-    LOG(2, "    size                 %lx (%ld)", GET_SIZE(PREV_PTR(p)), GET_SIZE(PREV_PTR(p)));
-    LOG(2, "    status               %d\n", GET_STATUS(PREV_PTR(p)));
-    
-    size_t chunk_size = ceil((double)(req_size - size + 1) / CHUNKSIZE) * CHUNKSIZE;
-    if (chunk_size < INITCHUNK)
-      chunk_size = INITCHUNK;
-    
-    LOG(2, "   increment heap by 0x%lx (%ld) bytes", chunk_size, chunk_size);
-    LOG(1, "ds_sbrk(+0x%lx)", chunk_size);
-    ds_sbrk(chunk_size);
-    heap_end = ds_heap_brk = ds_sbrk(0);
-    heap_end = (TYPE*)(((TYPE)heap_end - 1) / BS * BS);
-
-    LOG(1, "ds_sbrk(+0x%lx)", 0);
-    LOG(2, "  new heap_end at %p", heap_end);
-    
-    LOG(1, "coalesce()");
-    LOG(2, "  coalescing with preceeding block");
-    
-    size += (size_t)(heap_end - p);
-    start_alloc = heap_end - size;
-    LOG(2, "  last block now at %p with size 0x%lx (%ld) bytes", start_alloc, size, size);
-    
-    TYPE bdrtag = PACK(size, FREE);
-    PUT(start_alloc, bdrtag);
-    PUT(PREV_PTR(heap_end), bdrtag);
-    PUT(heap_end, PACK(0, ALLOC));
-    
-    next_block = start_alloc;
+  LOG(1, "expand_heap(0x%lx (%ld))", req_size, req_size);
+
+  void *p = heap_end;
+  size_t size = (GET_STATUS(PREV_PTR(p)) == FREE) ? GET_SIZE(PREV_PTR(p)) : 0;
+  LOG(2, "  last block");
+  LOG(2, "    header               %p", START(PREV_PTR(p)));
+  LOG(2, "    footer               %p", PREV_PTR(p));
+  LOG(2, "    size                 %lx (%ld)", GET_SIZE(PREV_PTR(p)), GET_SIZE(PREV_PTR(p)));
+  LOG(2, "    status               %d\n", GET_STATUS(PREV_PTR(p)));
+
+  size_t min_chunk_size = ceil((double)(req_size - size + 1) / CHUNKSIZE) * CHUNKSIZE;
+  size_t chunk_size = MAX(min_chunk_size, INITCHUNK);
+
+  LOG(2, "   increment heap by 0x%lx (%ld) bytes", chunk_size, chunk_size);
+  LOG(1, "ds_sbrk(+0x%lx)", chunk_size);
+  if (ds_sbrk(chunk_size) == (void*)-1) {
+    // under memory pressure, try again with the smallest possible increment
+    if ((chunk_size == min_chunk_size) || (ds_sbrk(min_chunk_size) == (void*)-1)) {
+      LOG(1, "  cannot extend heap by 0x%lx (%ld) bytes", min_chunk_size, min_chunk_size);
+      return NULL;
+    }
   }
+
+  if (size) fl_remove(START(PREV_PTR(p)));
+
+  heap_end = ds_heap_brk = ds_sbrk(0);
+  heap_end = (TYPE*)(((TYPE)heap_end - 1) / BS * BS);
+
+  LOG(1, "ds_sbrk(+0x%lx)", 0);
+  LOG(2, "  new heap_end at %p", heap_end);
+
+  LOG(1, "coalesce()");
+  LOG(2, "  coalescing with preceeding block");
+
+  size += (size_t)(heap_end - p);
+  void *last_block = heap_end - size;
+  LOG(2, "  last block now at %p with size 0x%lx (%ld) bytes", last_block, size, size);
+
+  TYPE bdrtag = PACK(size, FREE);
+  PUT(last_block, bdrtag);
+  PUT(PREV_PTR(heap_end), bdrtag);
+  PUT(heap_end, PACK(0, ALLOC));
+
+  fl_insert(last_block);
+  return next_block = last_block;
+}
+
+/// @brief mark the first @a req_size bytes of the free block @a start_alloc as allocated and
+///        split off the remainder as a new free block. Remainders smaller than the minimal
+///        block size are not split off but added to the allocated block.
+/// @param start_alloc pointer to header of free block
+/// @param req_size size of allocated block (including header & footer tags), in bytes
+/// @retval void* pointer to the payload of the allocated block
+static void* place(void *start_alloc, size_t req_size)
+{
   size_t prev_size = GET_SIZE(start_alloc);
+  size_t cur_size = prev_size - req_size;
+  if (cur_size < BS) {
+    req_size = prev_size;
+    cur_size = 0;
+    fl_remove(start_alloc);
+  }
+
   void *end_alloc = PREV_PTR(start_alloc + req_size);
-  
+
   TYPE bdrtag_alloc = PACK(req_size, ALLOC);
   PUT(start_alloc, bdrtag_alloc);
   PUT(end_alloc,   bdrtag_alloc);
-  
-  size_t cur_size = prev_size - req_size;
+
   if (cur_size) {
     void *start_free = start_alloc + req_size;
     void *end_free = PREV_PTR(start_free + cur_size);
 
-    TYPE bdrtag_free = PACK(cur_size, FREE);
+    // the remainder's purge range lies within that of the original block
+    TYPE bdrtag_free = PACK(cur_size, FREE | (GET(end_free) & PURGED));
     PUT(start_free, bdrtag_free);
     PUT(end_free,   bdrtag_free);
+
+    // the remainder takes the place of the allocated block in the free list
+    fl_replace(start_alloc, start_free);
   }
-  
+
   return start_alloc + TYPE_SIZE;
 }
 
+/// @brief find a free block of at least @a req_size bytes, extending the heap if necessary
+/// @param req_size size of block (including header & footer tags), in bytes
+/// @retval void* pointer to header of large enough free block
+/// @retval NULL if the heap cannot be extended
+static void* find_block(size_t req_size)
+{
+  void *block = get_free_block(req_size);
+  if (block == NULL) block = expand_heap(req_size);
+
+  return block;
+}
+
+void* mm_malloc(size_t size)
+{
+  LOG(1, "mm_malloc(0x%lx (%ld))", size, size);
+
+  assert(mm_initialized);
+  if (size > MAX_SIZE) return NULL;
+  size_t req_size = ceil((double)(size + 2*TYPE_SIZE) / BS) * BS;
+
+  void *start_alloc = find_block(req_size);
+  if (start_alloc == NULL) return NULL;
+
+  return place(start_alloc, req_size);
+}
+
 void* mm_calloc(size_t nmemb, size_t size)
 {
   LOG(1, "mm_calloc(0x%lx, 0x%lx)", nmemb, size);
@@ -306,37 +541,177 @@ void* mm_calloc(size_t nmemb, size_t size)
   assert(mm_initialized);
 
   //
-  // calloc is simply malloc() followed by memset()
+  // calloc is malloc() followed by memset(). Pages of purged blocks are already zero.
   //
-  void *payload = mm_malloc(nmemb * size);
+  if ((size != 0) && (nmemb > MAX_SIZE / size)) return NULL;
+  size_t len = nmemb * size;
+  size_t req_size = ceil((double)(len + 2*TYPE_SIZE) / BS) * BS;
+
+  void *block = find_block(req_size);
+  if (block == NULL) return NULL;
+
+  void *from = NULL, *to = NULL;
+  if (IS_PURGED(block)) purge_range(block, &from, &to);
+
+  void *payload = place(block, req_size);
+  void *payload_end = payload + len;
 
-  if (payload != NULL) memset(payload, 0, nmemb * size);
+  if ((from >= to) || (to <= payload) || (from >= payload_end)) {
+    memset(payload, 0, len);
+  } else {
+    LOG(2, "  skipping purged pages %p - %p", from, to);
+    if (from > payload) memset(payload, 0, from - payload);
+    if (to < payload_end) memset(to, 0, payload_end - to);
+  }
 
   return payload;
 }
 
+void* mm_memalign(size_t alignment, size_t size)
+{
+  LOG(1, "mm_memalign(0x%lx, 0x%lx (%ld))", alignment, size, size);
+
+  assert(mm_initialized);
+
+  //
+  // payloads are always word-aligned; alignment must be a power of 2
+  //
+  if ((alignment == 0) || (alignment & (alignment - 1))) return NULL;
+  if (alignment <= TYPE_SIZE) return mm_malloc(size);
+  if ((size > MAX_SIZE) || (alignment > MAX_SIZE)) return NULL;
+
+  //
+  // the aligned block needs a leading free fragment of at least BS bytes (or none at all) so
+  // that its payload ends up aligned. Search for a block that is large enough for the largest
+  // such fragment and the rounding of the block end below.
+  //
+  size_t req_size = ceil((double)(size + 2*TYPE_SIZE) / BS) * BS;
+  size_t search_size = req_size + alignment + 2*BS;
+
+  void *block = find_block(search_size);
+  if (block == NULL) return NULL;
+
+  void *payload = PTR((WORD(block) + TYPE_SIZE + alignment - 1) & ~(alignment - 1));
+  while ((payload - TYPE_SIZE != block) && (payload - TYPE_SIZE - block < BS)) {
+    payload += alignment;
+  }
+
+  //
+  // split off the leading fragment as a free block
+  //
+  size_t prefix = payload - TYPE_SIZE - block;
+  if (prefix) {
+    LOG(2, "  splitting off leading free fragment of 0x%lx (%ld) bytes", prefix, prefix);
+    size_t rest = GET_SIZE(block) - prefix;
+
+    TYPE bdrtag = PACK(prefix, FREE);
+    PUT(block, bdrtag);
+    PUT(PREV_PTR(block + prefix), bdrtag);
+
+    void *prefix_block = block;
+    block += prefix;
+    bdrtag = PACK(rest, FREE);
+    PUT(block, bdrtag);
+    PUT(END(block), bdrtag);
+
+    fl_replace(prefix_block, block);
+    fl_insert(prefix_block);
+  }
+
+  //
+  // end the allocated block on a BS boundary so that the remainder stays aligned
+  //
+  req_size = ((WORD(block) + req_size + BS - 1) & BS_MASK) - WORD(block);
+
+  return place(block, req_size);
+}
+
+size_t mm_usable_size(void *ptr)
+{
+  if (ptr == NULL) return 0;
+  assert(mm_initialized);
+
+  return GET_SIZE(PREV_PTR(ptr)) - 2*TYPE_SIZE;
+}
+
 void* mm_realloc(void *ptr, size_t size)
 {
   LOG(1, "mm_realloc(%p, 0x%lx)", ptr, size);
   assert(mm_initialized);
 
   if (ptr == NULL) return mm_malloc(size);
-  mm_free(ptr);
-  
-  void *(*prev_get_free_block)(size_t) = get_free_block;
-  void *prev_next_block = next_block;
-  
-  get_free_block = nf_get_free_block;
-  next_block = PREV_PTR(ptr);
-  
+  if (size == 0) {
+    mm_free(ptr);
+    return NULL;
+  }
+  if (size > MAX_SIZE) return NULL;
+
+  void *block = PREV_PTR(ptr);
+  size_t cur_size = GET_SIZE(block);
+  size_t req_size = ceil((double)(size + 2*TYPE_SIZE) / BS) * BS;
+
+  //
+  // grow in place if the succeeding block is free and large enough
+  //
+  void *next = block + cur_size;
+  if ((req_size > cur_size) && (next != heap_end) && (GET_STATUS(next) == FREE) &&
+      (cur_size + GET_SIZE(next) >= req_size))
+  {
+    LOG(2, "  growing in place into succeeding block");
+    size_t total = cur_size + GET_SIZE(next);
+    size_t rest = total - req_size;
+    TYPE purged = GET(next) & PURGED;
+    fl_remove(next);
+    if (rest < BS) {
+      req_size = total;
+      rest = 0;
+    }
+
+    TYPE bdrtag = PACK(req_size, ALLOC);
+    PUT(block, bdrtag);
+    PUT(END(block), bdrtag);
+
+    if (rest) {
+      void *start_free = block + req_size;
+      bdrtag = PACK(rest, FREE | purged);
+      PUT(start_free, bdrtag);
+      PUT(END(start_free), bdrtag);
+      fl_insert(start_free);
+    }
+
+    return ptr;
+  }
+
+  //
+  // shrink in place by splitting off the tail and freeing it
+  //
+  if (req_size <= cur_size) {
+    if (cur_size - req_size >= BS) {
+      LOG(2, "  shrinking in place");
+      void *tail = block + req_size;
+
+      TYPE bdrtag = PACK(req_size, ALLOC);
+      PUT(block, bdrtag);
+      PUT(END(block), bdrtag);
+
+      bdrtag = PACK(cur_size - req_size, ALLOC);
+      PUT(tail, bdrtag);
+      PUT(END(tail), bdrtag);
+      mm_free(NEXT_PTR(tail));
+    }
+
+    return ptr;
+  }
+
+  //
+  // move block
+  //
   void *new_ptr = mm_malloc(size);
-  if (new_ptr != ptr) {
-    memcpy(new_ptr, ptr, GET_SIZE(next_block) - 2*TYPE_SIZE);
+  if (new_ptr != NULL) {
+    memcpy(new_ptr, ptr, cur_size - 2*TYPE_SIZE);
+    mm_free(ptr);
   }
-  
-  get_free_block = prev_get_free_block;
-  next_block = prev_next_block;
-  
+
   return new_ptr;
 }
 
@@ -345,76 +720,80 @@ void mm_free(void *ptr)
   LOG(1, "mm_free(%p)", ptr);
   if (ptr == NULL) return;
   assert(mm_initialized);
-  
+
   ptr = PREV_PTR(ptr);
-  
+  size_t size = GET_SIZE(ptr);
+  int in_list = 0;
+  void *clean[4] = { NULL, NULL, NULL, NULL };   // purge ranges of purged neighbors
+  nfreed += size;
+
   LOG(1, "coalesce()");
-  TYPE bdrtag = PACK(GET_SIZE(ptr), FREE);
-  PUT(ptr, bdrtag);
-  PUT(END(ptr), bdrtag);
-  
-  // preceeding free block
+
+  // preceeding free block. The coalesced block keeps its position in the free list
   if (ptr != heap_start && GET_STATUS(PREV_PTR(ptr)) == FREE) {
     LOG(2, "  coalescing with preceeding block");
-    void *prev_ptr = START(PREV_PTR(ptr));
-    size_t size = GET_SIZE(prev_ptr) + GET_SIZE(ptr);
-    TYPE bdrtag = PACK(size, FREE);
-    PUT(prev_ptr, bdrtag);
-    PUT(END(prev_ptr), bdrtag);
-    ptr = prev_ptr;
-    
-    next_block = prev_ptr;
+    ptr = START(PREV_PTR(ptr));
+    size += GET_SIZE(ptr);
+    in_list = 1;
+    if (IS_PURGED(ptr)) purge_range(ptr, &clean[0], &clean[1]);
   }
-  
+
   // succeeding free block
-  if (NEXT_PTR(END(ptr)) != heap_end && GET_STATUS(NEXT_PTR(END(ptr))) == FREE) {
+  void *next_ptr = ptr + size;
+  if (next_ptr != heap_end && GET_STATUS(next_ptr) == FREE) {
     LOG(2, "  coalescing with succeeding block");
-    void *next_ptr = NEXT_PTR(END(ptr));
-    TYPE bdrtag = PACK(GET_SIZE(next_ptr) + GET_SIZE(ptr), FREE);
-    PUT(ptr, bdrtag);
-    PUT(END(ptr), bdrtag);
-    
-    next_block = next_ptr;
-    
-    if (END(ptr) == PREV_PTR(heap_end)) {
-      LOG(1, "shrink_heap(0x%lx (%ld))", INITCHUNK, INITCHUNK);
-
-      void *p = PREV_PTR(heap_end);
-      size_t size = (GET_STATUS(p) == FREE) ? GET_SIZE(p) : 0;
-      LOG(2, "  last block");
-      LOG(2, "    header               %p", START(p));
-      LOG(2, "    footer               %p", p);
-      LOG(2, "    size                 %lx (%ld)", GET_SIZE(p), GET_SIZE(p));
-      LOG(2, "    status               %d\n", GET_STATUS(p));
-      
-      next_block = START(p);
-
-      size_t chunk_size = size > INITCHUNK ? ((size - INITCHUNK) / CHUNKSIZE) * CHUNKSIZE : 0;
-      if (chunk_size) {
-        LOG(2, "   decrement heap by 0x%lx (%ld) bytes", chunk_size, chunk_size);
-        LOG(1, "ds_sbrk(-0x%lx)", chunk_size);
-
-        void *last_block = START(PREV_PTR(heap_end));
-
-        ds_sbrk(-chunk_size);
-        heap_end = ds_heap_brk = ds_sbrk(0);
-        heap_end = (TYPE*)(((TYPE)heap_end - 1) / BS * BS);
-        size = heap_end - last_block;
-
-        TYPE bdrtag = PACK(size, FREE);
-        PUT(last_block, bdrtag);
-        PUT(PREV_PTR(heap_end), bdrtag);
-        PUT(heap_end, PACK(0, ALLOC));
-
-        LOG(1, "ds_sbrk(+0x%lx)", 0);
-        LOG(2, "  new heap_end at %p", heap_end);
-        LOG(2, "  last block now at %p with size 0x%lx (%ld) bytes", last_block, size, size);
-        
-        next_block = last_block;
-      }
+    if (IS_PURGED(next_ptr)) purge_range(next_ptr, &clean[2], &clean[3]);
+    size += GET_SIZE(next_ptr);
+    if (in_list) fl_remove(next_ptr);
+    else fl_replace(next_ptr, ptr);
+    in_list = 1;
+  }
+
+  TYPE bdrtag = PACK(size, FREE);
+  PUT(ptr, bdrtag);
+  PUT(END(ptr), bdrtag);
+  if (!in_list) fl_insert(ptr);
+
+  // return memory to the data segment if the last block has become large enough
+  if ((ptr + size == heap_end) && (size > INITCHUNK)) {
+    LOG(1, "shrink_heap(0x%lx (%ld))", INITCHUNK, INITCHUNK);
+    LOG(2, "  last block");
+    LOG(2, "    header               %p", ptr);
+    LOG(2, "    footer               %p", END(ptr));
+    LOG(2, "    size                 %lx (%ld)", size, size);
+
+    size_t chunk_size = ((size - INITCHUNK) / CHUNKSIZE) * CHUNKSIZE;
+    if (chunk_size) {
+      LOG(2, "   decrement heap by 0x%lx (%ld) bytes", chunk_size, chunk_size);
+      LOG(1, "ds_sbrk(-0x%lx)", chunk_size);
+
+      if (ds_sbrk(-chunk_size) == (void*)-1) return;
+      heap_end = ds_heap_brk = ds_sbrk(0);
+      heap_end = (TYPE*)(((TYPE)heap_end - 1) / BS * BS);
+      size = heap_end - ptr;
+
+      // the header stays in place, hence the block keeps its position in the free list
+      TYPE bdrtag = PACK(size, FREE);
+      PUT(ptr, bdrtag);
+      PUT(PREV_PTR(heap_end), bdrtag);
+      PUT(heap_end, PACK(0, ALLOC));
+
+      LOG(1, "ds_sbrk(+0x%lx)", 0);
+      LOG(2, "  new heap_end at %p", heap_end);
+      LOG(2, "  last block now at %p with size 0x%lx (%ld) bytes", ptr, size, size);
     }
   }
-  
+
+  // the coalesced block stays purged if the ranges of its purged neighbors cover its range
+  if (purgeable(ptr)) {
+    void *from, *to;
+    purge_range(ptr, &from, &to);
+    if (clean[0] < clean[1] && clean[0] <= from) from = MAX(from, clean[1]);
+    if (clean[2] < clean[3] && clean[2] <= from) from = MAX(from, clean[3]);
+    if (from >= to) set_flags(ptr, PURGED);
+  }
+
+  if (purge_threshold && (nfreed >= PURGE_RATIO * purge_threshold)) purge_pass();
 }
 
 /// @name block allocation policites
@@ -438,6 +817,8 @@ static void* ff_get_free_block(size_t size)
     p += GET_SIZE(p);
     N++;
   }
+  nsearch++;
+  ntries += N;
   if (p >= heap_end || GET_STATUS(p) == ALLOC) {
     LOG(2, "    %p %d %d", p, GET_SIZE(p), GET_STATUS(p));
     LOG(1, "  no suitable block found after %d tries.", N);
@@ -447,29 +828,39 @@ static void* ff_get_free_block(size_t size)
   return p;
 }
 
-/// @brief find and return a free block of at least @a size bytes (next fit)
+/// @brief find and return a free block of at least @a size bytes (next fit). The search walks
+///        the free list starting at the rover and stops after one round.
 /// @param size size of block (including header & footer tags), in bytes
 /// @retval void* pointer to header of large enough free block
 /// @retval NULL if no free block of the requested size is avilable
 static void* nf_get_free_block(size_t size)
 {
-  LOG(1, "nf_get_free_block(0x%x (%lu))", size, size);
+  LOG(1, "nf_get_free_block(0x%lx (%lu))", size, size);
   assert(mm_initialized);
   void *p = next_block;
   int N = 0;
+
+  nsearch++;
+  if (p == NULL) {
+    LOG(1, "  no free blocks.");
+    return NULL;
+  }
+
   LOG(2, "  starting search at %p", p);
   do {
     N++;
     LOG(2, "    %p %ld %d", p, GET_SIZE(p), GET_STATUS(p));
-    if ((GET_STATUS(p) == FREE) && (GET_SIZE(p) >= size)) break;
-    p = (GET_SIZE(p) > 0) ? p + GET_SIZE(p) : heap_start;
+    if (GET_SIZE(p) >= size) {
+      ntries += N;
+      LOG(1, "    --> match after %d tries.", N);
+      return next_block = p;
+    }
+    p = NEXT_FREE(p);
   } while (p != next_block);
-  if (p == next_block && ((GET_STATUS(p) == ALLOC) || (GET_SIZE(p) < size))) {
-    LOG(1, "  no suitable block found after %d tries.", N);
-    return NULL;
-  }
-  LOG(1, "    --> match after %d tries.", N);
-  return next_block = p;
+
+  ntries += N;
+  LOG(1, "  no suitable block found after %d tries.", N);
+  return NULL;
 }
 
 /// @brief find and return a free block of at least @a size bytes (best fit)
@@ -496,6 +887,8 @@ static void* bf_get_free_block(size_t size)
     N++;
   }
   LOG(2, "    %p %ld %d", p, GET_SIZE(p), GET_STATUS(p));
+  nsearch++;
+  ntries += N;
   if (best == NULL) {
     LOG(1, "  no suitable block found after %d tries.", N);
     return NULL;
@@ -506,13 +899,35 @@ static void* bf_get_free_block(size_t size)
 
 /// @}
 
+void mm_search_stat(size_t *searches, size_t *tries)
+{
+  if (searches) *searches = nsearch;
+  if (tries)    *tries    = ntries;
+}
+
+void mm_setpurge(size_t threshold)
+{
+  purge_threshold = threshold;
+}
+
+size_t mm_getpurged(void)
+{
+  return npurged;
+}
+
 void mm_setloglevel(int level)
 {
   mm_loglevel = level;
 }
 
 
-void mm_check(void)
+/// @brief print to stdout if verbose is set (check_heap() only)
+#define DUMP(...)          do { if (verbose) printf(__VA_ARGS__); } while (0)
+
+/// @brief traverse the heap and perform some sanity checks
+/// @param verbose dump the heap (1) or only count errors (0)
+/// @retval long number of errors detected
+static long check_heap(int verbose)
 {
   assert(mm_initialized);
 
@@ -524,32 +939,42 @@ void mm_check(void)
   else apstr = "invalid";
 
   LOG(2, "  allocation policy    %s\n", apstr);
-  printf("\n----------------------------------------- mm_check ----------------------------------------------\n");
-  printf("  ds_heap_start:          %p\n", ds_heap_start);
-  printf("  ds_heap_brk:            %p\n", ds_heap_brk);
-  printf("  heap_start:             %p\n", heap_start);
-  printf("  heap_end:               %p\n", heap_end);
-  printf("  allocation policy:      %s\n", apstr);
-  printf("  next_block:             %p\n", next_block);   // this will be needed for the next fit policy
-
-  printf("\n");
+  DUMP("\n----------------------------------------- mm_check ----------------------------------------------\n");
+  DUMP("  ds_heap_start:          %p\n", ds_heap_start);
+  DUMP("  ds_heap_brk:            %p\n", ds_heap_brk);
+  DUMP("  heap_start:             %p\n", heap_start);
+  DUMP("  heap_end:               %p\n", heap_end);
+  DUMP("  allocation policy:      %s\n", apstr);
+  DUMP("  next_block:             %p\n", next_block);   // this will be needed for the next fit policy
+
+  DUMP("\n");
   p = PREV_PTR(heap_start);
-  printf("  initial sentinel:       %p: size: %6lx (%7ld), status: %s\n",
-         p, GET_SIZE(p), GET_SIZE(p), GET_STATUS(p) == ALLOC ? "allocated" : "free");
+  DUMP("  initial sentinel:       %p: size: %6lx (%7ld), status: %s\n",
+       p, GET_SIZE(p), GET_SIZE(p), GET_STATUS(p) == ALLOC ? "allocated" : "free");
   p = heap_end;
-  printf("  end sentinel:           %p: size: %6lx (%7ld), status: %s\n",
-         p, GET_SIZE(p), GET_SIZE(p), GET_STATUS(p) == ALLOC ? "allocated" : "free");
-  printf("\n");
-  printf("  blocks:\n");
+  DUMP("  end sentinel:           %p: size: %6lx (%7ld), status: %s\n",
+       p, GET_SIZE(p), GET_SIZE(p), GET_STATUS(p) == ALLOC ? "allocated" : "free");
+  DUMP("\n");
+  DUMP("  blocks:\n");
 
   long errors = 0;
+  size_t nfree = 0;
+
+  if ((GET(PREV_PTR(heap_start)) != PACK(0, ALLOC)) || (GET(heap_end) != PACK(0, ALLOC)) ||
+      (heap_end + TYPE_SIZE > ds_heap_brk))
+  {
+    errors++;
+    DUMP("    --> ERROR: invalid sentinels or heap_end beyond brk.\n");
+  }
+
   p = heap_start;
   while (p < heap_end) {
     TYPE hdr = GET(p);
     TYPE size = SIZE(hdr);
     TYPE status = STATUS(hdr);
-    printf("    %p: size: %6lx (%7ld), status: %s\n", 
-           p, size, size, status == ALLOC ? "allocated" : "free");
+    if (status == FREE) nfree++;
+    DUMP("    %p: size: %6lx (%7ld), status: %s\n",
+         p, size, size, status == ALLOC ? "allocated" : IS_PURGED(p) ? "free (purged)" : "free");
 
     void *fp = p + size - TYPE_SIZE;
     TYPE ftr = GET(fp);
@@ -558,18 +983,79 @@ void mm_check(void)
 
     if ((size != fsize) || (status != fstatus)) {
       errors++;
-      printf("    --> ERROR: footer at %p with different properties: size: %lx, status: %lx\n", 
-             fp, fsize, fstatus);
+      DUMP("    --> ERROR: footer at %p with different properties: size: %lx, status: %lx\n",
+           fp, fsize, fstatus);
     }
 
     p = p + size;
     if (size == 0) {
-      printf("    WARNING: size 0 detected, aborting traversal.\n");
+      errors++;
+      DUMP("    WARNING: size 0 detected, aborting traversal.\n");
       break;
     }
   }
 
-  printf("\n");
-  if ((p == heap_end) && (errors == 0)) printf("  Block structure coherent.\n");
-  printf("-------------------------------------------------------------------------------------------------\n");
+  void *heap_p = p;
+
+  //
+  // every free block must be in the free list exactly once
+  //
+  DUMP("\n");
+  DUMP("  free list:\n");
+  size_t nlist = 0;
+  if ((p = next_block) != NULL) {
+    do {
+      if ((GET_STATUS(p) != FREE) || (PREV_FREE(NEXT_FREE(p)) != p)) {
+        errors++;
+        DUMP("    --> ERROR: invalid free list entry %p\n", p);
+        break;
+      }
+      nlist++;
+      p = NEXT_FREE(p);
+    } while ((p != next_block) && (nlist <= nfree));
+  }
+  DUMP("    %lu free blocks, %lu in free list\n", nfree, nlist);
+  if (nlist != nfree) errors++;
+
+  DUMP("\n");
+  if (heap_p != heap_end) errors++;
+  if (errors == 0) DUMP("  Block structure coherent.\n");
+  DUMP("-------------------------------------------------------------------------------------------------\n");
+
+  return errors;
+}
+
+void mm_check(void)
+{
+  check_heap(1);
+}
+
+long mm_verify(void)
+{
+  return check_heap(0);
+}
+
+
+int mm_snapshot(FILE *f, uint32_t id)
+{
+  assert(mm_initialized);
+
+  MMSnapshot ss = {
+    .magic     = MM_SNAPSHOT_MAGIC,
+    .id        = id,
+    .heap_size = heap_end - heap_start,
+    .nblocks   = 0,
+  };
+
+  void *p;
+  for (p = heap_start; (p < heap_end) && (GET_SIZE(p) > 0); p += GET_SIZE(p)) ss.nblocks++;
+  if (p != heap_end) return -1;
+
+  if (fwrite(&ss, sizeof(ss), 1, f) != 1) return -1;
+  for (p = heap_start; p < heap_end; p += GET_SIZE(p)) {
+    uint64_t tag = GET(p);
+    if (fwrite(&tag, sizeof(tag), 1, f) != 1) return -1;
+  }
+
+  return 0;
 }
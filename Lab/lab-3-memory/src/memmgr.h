@@ -35,6 +35,8 @@
 #define __MEMMGR_H__
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 
 /// @brief supported allocation policies
 typedef enum {
@@ -43,6 +45,18 @@ typedef enum {
   ap_BestFit,                     ///< best fit allocation policy
 } AllocationPolicy;
 
+/// @brief magic number identifying a heap snapshot
+#define MM_SNAPSHOT_MAGIC 0x534e534d       // "MSNS"
+
+/// @brief header of a heap snapshot as written by mm_snapshot(). The header is followed by
+///        @a nblocks 64-bit boundary tags (size | status) of all blocks in address order.
+typedef struct {
+  uint32_t magic;                 ///< MM_SNAPSHOT_MAGIC
+  uint32_t id;                    ///< snapshot identifier provided by the caller
+  uint64_t heap_size;             ///< size of the heap (heap_end - heap_start) in bytes
+  uint64_t nblocks;               ///< number of blocks
+} MMSnapshot;
+
 /// @brief initialize heap. Must be called before any of the other functions can be used.
 void mm_init(AllocationPolicy ap);
 
@@ -66,10 +80,38 @@ void* mm_calloc(size_t nelem, size_t size);
 /// @retval NULL if memory allocation failed
 void* mm_realloc(void *ptr, size_t size);
 
+/// @brief allocate a block of memory of @a size bytes whose payload is aligned to @a alignment
+///        bytes. The padding in front of the payload is split off as a free block.
+/// @param alignment alignment of the payload in bytes. Must be a power of 2
+/// @param size requested size in bytes
+/// @retval void* pointer to first byte of aligned memory on success
+/// @retval NULL if memory allocation failed or @a alignment is invalid
+void* mm_memalign(size_t alignment, size_t size);
+
+/// @brief return the number of usable bytes in the block pointed to by @a ptr
+/// @param ptr pointer to allocated memory or NULL
+/// @retval size_t payload size of the block (0 if @a ptr is NULL)
+size_t mm_usable_size(void *ptr);
+
 /// @brief free a previously allocated block of memory
 /// @param ptr pointer to allocated memory obtained by calling mm_malloc, mm_calloc, or mm_realloc
 void mm_free(void *ptr);
 
+/// @brief retrieve statistics about the free block searches of the allocation policy
+/// @param[out] searches number of free block searches since mm_init()
+/// @param[out] tries    total number of blocks inspected by these searches
+void mm_search_stat(size_t *searches, size_t *tries);
+
+/// @brief set the minimal size of free blocks whose pages are released to the OS with
+///        madvise(MADV_DONTNEED). Blocks are purged in passes over the free list after every
+///        16 * @a threshold freed bytes.
+/// @param threshold minimal block size in bytes (0: never purge)
+void mm_setpurge(size_t threshold);
+
+/// @brief retrieve the number of bytes released to the OS by purging free blocks
+/// @retval size_t number of purged bytes since mm_init()
+size_t mm_getpurged(void);
+
 /// @brief set log level
 /// @brief level log level (0: no logging, 1: info; 2: verbose)
 void mm_setloglevel(int level);
@@ -77,4 +119,16 @@ void mm_setloglevel(int level);
 /// @brief dump heap and perform some sanity checks
 void mm_check(void);
 
+/// @brief perform the sanity checks of mm_check() without dumping the heap
+/// @retval long number of errors detected (0: heap is consistent)
+long mm_verify(void);
+
+/// @brief write a binary snapshot of the block structure of the heap to @a f. The snapshot
+///        consists of a MMSnapshot header followed by the boundary tags of all blocks.
+/// @param f output file
+/// @param id snapshot identifier stored in the header
+/// @retval 0 on success
+/// @retval -1 on error
+int mm_snapshot(FILE *f, uint32_t id);
+
 #endif // __MEMMGR_H__
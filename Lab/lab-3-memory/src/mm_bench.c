@@ -0,0 +1,424 @@
+//--------------------------------------------------------------------------------------------------
+// System Programming                       Memory Lab                                   Fall 2021
+//
+/// @file
+/// @brief dynamic memory manager benchmarks
+/// @author agent <agent@local>
+//--------------------------------------------------------------------------------------------------
+
+
+// Benchmarks
+// ==========
+// Usage: mm_bench <benchmark> [options]
+//
+// align [n]      compare the heap waste of mm_memalign() against over-allocating with mm_malloc()
+//                and rounding up the payload pointer. Interleaves n aligned allocations (64 bytes
+//                and page size) with small mallocs and random frees.
+//
+// oom [rate] [n]
+//                random malloc/calloc/realloc/memalign/free workload on a small data segment
+//                while ds_sbrk() fails with probability rate (default 0.1). Checks that failed
+//                requests return NULL, that the heap stays consistent (mm_verify()), and that
+//                the payloads of live blocks are preserved. Runs n operations per policy.
+//
+// trace <script> [snapshot|- [n]]
+//                replay a mm_driver script (tests/*.dmas) and report the execution time. At
+//                every 'v' and 'stat' command and, if n > 0, after every n-th action, the heap
+//                size and the resident set size of the heap are printed and, if a snapshot file
+//                is given, a heap snapshot (see mm_snapshot()) is appended to it. Use mm_heapviz
+//                to render the snapshots.
+//
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dataseg.h"
+#include "memmgr.h"
+
+#define MAX(a, b)    ((a) > (b) ? (a) : (b))       ///< MAX function
+#define MIN(a, b)    ((a) < (b) ? (a) : (b))       ///< MIN function
+#define DS_SIZE      (64*1024*1024)                    ///< size of the simulated data segment
+#define NSMALL       4                                 ///< small allocations per aligned one
+#define NSLOTS       256                               ///< number of live allocation slots
+
+/// @brief benchmark statistics
+typedef struct {
+  size_t requested;                                    ///< requested payload bytes
+  size_t usable;                                       ///< usable payload bytes
+  size_t heap;                                         ///< final heap size
+  size_t peak;                                         ///< peak heap size
+} Stats;
+
+
+/// @brief return the current size of the simulated heap
+static size_t heap_size(void)
+{
+  void *start, *brk;
+  ds_heap_stat(&start, &brk, NULL);
+  return brk - start;
+}
+
+/// @brief run the aligned allocation workload
+/// @param n number of aligned allocations
+/// @param alignment payload alignment
+/// @param memalign use mm_memalign() (1) or over-allocation with mm_malloc() (0)
+/// @param[out] s statistics
+static void align_workload(int n, size_t alignment, int memalign, Stats *s)
+{
+  void *slot[NSLOTS] = { NULL };
+  size_t req[NSLOTS] = { 0 };
+
+  ds_allocate(DS_SIZE);
+  mm_init(ap_FirstFit);
+  memset(s, 0, sizeof(*s));
+  srand(42);
+
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j <= NSMALL; j++) {
+      int k = rand() % NSLOTS;
+      if (slot[k] != NULL) {
+        s->usable -= mm_usable_size(slot[k]);
+        s->requested -= req[k];
+        mm_free(slot[k]);
+        slot[k] = NULL;
+      }
+
+      size_t size;
+      void *p;
+      if (j == 0) {
+        size = 64 + rand() % 4096;
+        if (memalign) {
+          p = mm_memalign(alignment, size);
+        } else {
+          p = mm_malloc(size + alignment - 1);
+        }
+      } else {
+        size = 16 + rand() % 256;
+        p = mm_malloc(size);
+      }
+
+      if (p == NULL) {
+        fprintf(stderr, "Allocation failed.\n");
+        exit(EXIT_FAILURE);
+      }
+      if (memalign && (j == 0) && (((unsigned long)p) % alignment)) {
+        fprintf(stderr, "mm_memalign(%lu) returned misaligned pointer %p.\n", alignment, p);
+        exit(EXIT_FAILURE);
+      }
+
+      slot[k] = p;
+      req[k] = size;
+      s->usable += mm_usable_size(p);
+      s->requested += size;
+      if (heap_size() > s->peak) s->peak = heap_size();
+    }
+  }
+  s->heap = heap_size();
+
+  ds_release();
+}
+
+/// @brief compare mm_memalign() against over-allocation
+/// @param n number of aligned allocations
+static void bench_align(int n)
+{
+  size_t alignment[] = { 64, getpagesize() };
+
+  printf("  %6s  %-12s  %12s  %12s  %8s  %12s  %12s\n",
+         "align", "method", "requested", "usable", "waste", "heap", "peak heap");
+  for (size_t a = 0; a < sizeof(alignment)/sizeof(alignment[0]); a++) {
+    for (int memalign = 0; memalign <= 1; memalign++) {
+      Stats s;
+      align_workload(n, alignment[a], memalign, &s);
+      printf("  %6lu  %-12s  %12lu  %12lu  %7.2f%%  %12lu  %12lu\n",
+             alignment[a], memalign ? "mm_memalign" : "over-alloc",
+             s.requested, s.usable, 100.0 * (s.usable - s.requested) / s.usable,
+             s.heap, s.peak);
+    }
+  }
+}
+
+/// @brief check that the first @a size bytes at @a p all equal @a c
+static int check_payload(const void *p, size_t size, unsigned char c)
+{
+  for (size_t i = 0; i < size; i++) if (((const unsigned char*)p)[i] != c) return 0;
+  return 1;
+}
+
+/// @brief run a random workload under memory pressure
+/// @param rate probability of a ds_sbrk() failure
+/// @param n number of operations per allocation policy
+static void bench_oom(double rate, int n)
+{
+  const char *apstr[] = { "first fit", "next fit", "best fit" };
+  void *slot[NSLOTS];
+  size_t len[NSLOTS];
+  unsigned char fill[NSLOTS];
+
+  printf("  %-10s  %10s  %10s  %10s  %8s\n", "policy", "requests", "failed", "faults", "errors");
+  for (AllocationPolicy ap = ap_FirstFit; ap <= ap_BestFit; ap++) {
+    size_t nreq = 0, nfail = 0, nerror = 0;
+
+    memset(slot, 0, sizeof(slot));
+    ds_allocate(4*1024*1024);
+    mm_init(ap);
+    ds_setfault(0, rate, 42);
+    srand(42);
+
+    for (int i = 0; i < n; i++) {
+      int k = rand() % NSLOTS;
+      size_t size = rand() % 2 ? 16 + rand() % 512 : rand() % (256*1024);
+      void *p = NULL;
+
+      if ((slot[k] != NULL) && !check_payload(slot[k], len[k], fill[k])) nerror++;
+
+      int op = rand() % 5;
+      if (op != 4) {
+        mm_free(slot[k]);
+        slot[k] = NULL;
+      }
+
+      if (op > 0) {
+        nreq++;
+        switch (op) {
+          case 1:
+            p = mm_calloc(1, size);
+            if ((p != NULL) && !check_payload(p, size, 0)) nerror++;
+            break;
+          case 2:
+            p = mm_memalign(64, size);
+            break;
+          case 3:
+            p = mm_malloc(size);
+            break;
+          case 4:
+            // a failed realloc leaves the old block untouched (checked in the next round)
+            size = MAX(size, 1);
+            p = mm_realloc(slot[k], size);
+            if ((p != NULL) && (slot[k] != NULL) && !check_payload(p, MIN(size, len[k]), fill[k])) {
+              nerror++;
+            }
+            break;
+        }
+
+        if (p == NULL) {
+          nfail++;
+        } else {
+          fill[k] = rand();
+          memset(p, fill[k], size);
+          slot[k] = p;
+          len[k] = size;
+        }
+      }
+
+      if (mm_verify() != 0) nerror++;
+    }
+
+    printf("  %-10s  %10lu  %10lu  %10ld  %8lu\n",
+           apstr[ap], nreq, nfail, ds_getnfault(), nerror);
+
+    ds_setfault(0, 0.0, 0);
+    ds_release();
+  }
+}
+
+/// @brief return the payload pointer of block @a id, growing the id table as needed. Negative
+///        ids refer to a scratch slot that always holds NULL.
+/// @param ptr pointer to id table
+/// @param nptr pointer to size of id table
+/// @param id block id
+/// @retval void** pointer to the slot of block @a id
+static void** trace_slot(void ***ptr, size_t *nptr, long id)
+{
+  static void *null_slot;
+
+  if (id < 0) {
+    null_slot = NULL;
+    return &null_slot;
+  }
+
+  if (id >= *nptr) {
+    size_t n = MAX(2 * *nptr, id + 1);
+    *ptr = realloc(*ptr, n * sizeof(void*));
+    if (*ptr == NULL) {
+      fprintf(stderr, "Out of memory.\n");
+      exit(EXIT_FAILURE);
+    }
+    memset(*ptr + *nptr, 0, (n - *nptr) * sizeof(void*));
+    *nptr = n;
+  }
+
+  return &(*ptr)[id];
+}
+
+/// @brief print the heap size and RSS and append a heap snapshot to @a ss (if not NULL)
+/// @param ss snapshot file or NULL
+/// @param id snapshot id
+/// @param nactions number of actions executed so far
+/// @param[in,out] peak peak resident bytes
+static void trace_sample(FILE *ss, uint32_t id, size_t nactions, size_t *peak)
+{
+  size_t resident = ds_getresident();
+  if (resident > *peak) *peak = resident;
+
+  printf("  [%4u] actions: %8lu  heap: %10lu  resident: %10lu\n", id, nactions, heap_size(), resident);
+
+  if ((ss != NULL) && (mm_snapshot(ss, id) != 0)) {
+    fprintf(stderr, "Cannot write heap snapshot %u.\n", id);
+  }
+}
+
+/// @brief replay a mm_driver script
+/// @param script script file name
+/// @param snapshot snapshot file name or NULL
+/// @param interval sample every @a interval actions (0: only at 'v' and 'stat')
+static void bench_trace(const char *script, const char *snapshot, size_t interval)
+{
+  FILE *f = fopen(script, "r");
+  if (f == NULL) {
+    fprintf(stderr, "Cannot open script '%s': %s.\n", script, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  FILE *ss = NULL;
+  if ((snapshot != NULL) && (strcmp(snapshot, "-") != 0) && ((ss = fopen(snapshot, "w")) == NULL)) {
+    fprintf(stderr, "Cannot open snapshot file '%s': %s.\n", snapshot, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  size_t ds_size = DS_SIZE;
+  AllocationPolicy ap = ap_FirstFit;
+  void **ptr = NULL;
+  size_t nptr = 0;
+  size_t nmalloc = 0, ncalloc = 0, nrealloc = 0, nfree = 0;
+  uint32_t nsnapshot = 0;
+  size_t peak = 0;
+  int started = 0, stopped = 0;
+  struct timespec t0, t1;
+
+  char *line = NULL;
+  size_t llen = 0;
+  unsigned long lineno = 0;
+  while (getline(&line, &llen, f) > 0) {
+    char cmd[16], arg[32];
+    long id;
+    size_t a;
+    lineno++;
+
+    if ((sscanf(line, "%15s", cmd) != 1) || (cmd[0] == '#')) continue;
+
+    if (!started) {
+      if ((strcmp(cmd, "dataseg") == 0) && (sscanf(line, "%*s %31s", arg) == 1)) {
+        ds_size = strtoul(arg, NULL, 0);
+      } else if ((strcmp(cmd, "heap") == 0) && (sscanf(line, "%*s %31s", arg) == 1)) {
+        if (strcmp(arg, "firstfit") == 0) ap = ap_FirstFit;
+        else if (strcmp(arg, "nextfit") == 0) ap = ap_NextFit;
+        else if (strcmp(arg, "bestfit") == 0) ap = ap_BestFit;
+        else fprintf(stderr, "%s:%lu: invalid policy '%s'.\n", script, lineno, arg);
+      } else if (strcmp(cmd, "start") == 0) {
+        ds_allocate(ds_size);
+        mm_init(ap);
+        started = 1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+      }
+      continue;
+    }
+
+    if ((strcmp(cmd, "v") == 0) || (strcmp(cmd, "stat") == 0)) {
+      trace_sample(ss, nsnapshot++, nmalloc + ncalloc + nrealloc + nfree, &peak);
+      continue;
+    } else if (stopped) {
+      continue;
+    }
+
+    if ((strcmp(cmd, "m") == 0) && (sscanf(line, "%*s %ld %lu", &id, &a) == 2)) {
+      *trace_slot(&ptr, &nptr, id) = mm_malloc(a);
+      nmalloc++;
+    } else if ((strcmp(cmd, "c") == 0) && (sscanf(line, "%*s %ld %lu", &id, &a) == 2)) {
+      *trace_slot(&ptr, &nptr, id) = mm_calloc(1, a);
+      ncalloc++;
+    } else if ((strcmp(cmd, "r") == 0) && (sscanf(line, "%*s %ld %lu", &id, &a) == 2)) {
+      void **p = trace_slot(&ptr, &nptr, id);
+      *p = mm_realloc(*p, a);
+      nrealloc++;
+    } else if ((strcmp(cmd, "f") == 0) && (sscanf(line, "%*s %ld", &id) == 1)) {
+      void **p = trace_slot(&ptr, &nptr, id);
+      mm_free(*p);
+      *p = NULL;
+      nfree++;
+    } else if (strcmp(cmd, "stop") == 0) {
+      clock_gettime(CLOCK_MONOTONIC, &t1);
+      stopped = 1;
+      continue;
+    } else {
+      fprintf(stderr, "%s:%lu: ignoring invalid line '%s'.\n", script, lineno, cmd);
+      continue;
+    }
+
+    size_t nactions = nmalloc + ncalloc + nrealloc + nfree;
+    if ((interval > 0) && (nactions % interval == 0)) {
+      trace_sample(ss, nsnapshot++, nactions, &peak);
+    }
+  }
+  if (!stopped) clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  double time = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+  size_t nactions = nmalloc + ncalloc + nrealloc + nfree;
+  size_t nsearch, ntries;
+  mm_search_stat(&nsearch, &ntries);
+
+  printf("  script file:        %s\n", script);
+  printf("  actions:            %lu\n", nactions);
+  printf("    malloc:           %lu\n", nmalloc);
+  printf("    calloc:           %lu\n", ncalloc);
+  printf("    realloc:          %lu\n", nrealloc);
+  printf("    free:             %lu\n", nfree);
+  printf("  heap size:          %lu\n", started ? heap_size() : 0);
+  printf("  resident:           %lu\n", started ? ds_getresident() : 0);
+  printf("    peak (sampled):   %lu\n", peak);
+  printf("    purged:           %lu\n", mm_getpurged());
+  printf("  searches:           %lu\n", nsearch);
+  printf("    avg. tries:       %.2f\n", nsearch ? (double)ntries / nsearch : 0.0);
+  printf("  samples:            %u\n", nsnapshot);
+  printf("  time:               %.9f sec\n", time);
+  printf("  performance:        %.2f kops/sec\n", nactions / time / 1000);
+
+  if (started) ds_release();
+  if (ss != NULL) fclose(ss);
+  free(line);
+  free(ptr);
+  fclose(f);
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <benchmark> [options]\n"
+                    "  align [n]                    mm_memalign() vs. over-allocation\n"
+                    "  oom [rate] [n]               allocator under ds_sbrk() failures\n"
+                    "  trace <script> [snapshot|- [n]]\n"
+                    "                               replay a mm_driver script\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  ds_setloglevel(0);
+  mm_setloglevel(0);
+
+  if (strcmp(argv[1], "align") == 0) {
+    bench_align(argc > 2 ? atoi(argv[2]) : 10000);
+  } else if (strcmp(argv[1], "oom") == 0) {
+    bench_oom(argc > 2 ? atof(argv[2]) : 0.1, argc > 3 ? atoi(argv[3]) : 20000);
+  } else if ((strcmp(argv[1], "trace") == 0) && (argc > 2)) {
+    bench_trace(argv[2], argc > 3 ? argv[3] : NULL, argc > 4 ? strtoul(argv[4], NULL, 0) : 0);
+  } else {
+    fprintf(stderr, "Invalid benchmark '%s'.\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
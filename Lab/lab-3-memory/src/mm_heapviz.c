@@ -0,0 +1,260 @@
+//--------------------------------------------------------------------------------------------------
+// System Programming                       Memory Lab                                   Fall 2021
+//
+/// @file
+/// @brief heap snapshot visualizer
+/// @author agent <agent@local>
+//--------------------------------------------------------------------------------------------------
+
+
+// Heap snapshot visualizer
+// ========================
+// Usage: mm_heapviz <snapshot file> [svg file]
+//
+// Reads the heap snapshots written by mm_snapshot() (e.g., with 'mm_bench trace') and prints
+// one line of fragmentation statistics per snapshot. If an svg file is given, the following
+// charts are rendered into it:
+//
+// - fragmentation map: one row per snapshot, the x-axis covers the heap. The darker a pixel,
+//   the more of the corresponding heap area is allocated. Free areas are green.
+// - largest free block and total free bytes over time
+// - histogram of the free block sizes (log2 buckets) of the last snapshot
+//
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memmgr.h"
+
+#define MAP_WIDTH    1024                              ///< width of the fragmentation map in px
+#define ROW_HEIGHT   6                                 ///< height of one map row in px
+#define CHART_HEIGHT 200                               ///< height of the charts in px
+#define MARGIN       40                                ///< margin around the charts in px
+#define NBUCKETS     48                                ///< number of log2 histogram buckets
+
+#define SIZE(tag)    ((tag) & ~(uint64_t)0x7)          ///< extract size from boundary tag
+#define STATUS(tag)  ((tag) & 0x1)                     ///< extract status from boundary tag
+
+/// @brief one heap snapshot
+typedef struct {
+  MMSnapshot hdr;                                      ///< snapshot header
+  uint64_t   *tag;                                     ///< boundary tags of all blocks
+  uint64_t   nfree;                                    ///< number of free blocks
+  uint64_t   free;                                     ///< free bytes
+  uint64_t   largest;                                  ///< largest free block
+} Snapshot;
+
+
+/// @brief read all snapshots from @a fn
+/// @param fn file name
+/// @param[out] n number of snapshots read
+/// @retval Snapshot* array of snapshots
+static Snapshot* read_snapshots(const char *fn, size_t *n)
+{
+  FILE *f = fopen(fn, "r");
+  if (f == NULL) {
+    fprintf(stderr, "Cannot open snapshot file '%s': %s.\n", fn, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  Snapshot *ss = NULL;
+  size_t cap = 0;
+  MMSnapshot hdr;
+
+  *n = 0;
+  while (fread(&hdr, sizeof(hdr), 1, f) == 1) {
+    if (hdr.magic != MM_SNAPSHOT_MAGIC) {
+      fprintf(stderr, "Invalid snapshot %lu in '%s'.\n", *n, fn);
+      exit(EXIT_FAILURE);
+    }
+
+    if (*n == cap) {
+      cap = cap ? 2*cap : 64;
+      if ((ss = realloc(ss, cap * sizeof(Snapshot))) == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        exit(EXIT_FAILURE);
+      }
+    }
+
+    Snapshot *s = &ss[*n];
+    memset(s, 0, sizeof(*s));
+    s->hdr = hdr;
+    s->tag = malloc(hdr.nblocks * sizeof(uint64_t));
+    if ((s->tag == NULL) || (fread(s->tag, sizeof(uint64_t), hdr.nblocks, f) != hdr.nblocks)) {
+      fprintf(stderr, "Truncated snapshot %u in '%s'.\n", hdr.id, fn);
+      exit(EXIT_FAILURE);
+    }
+
+    for (uint64_t b = 0; b < hdr.nblocks; b++) {
+      if (STATUS(s->tag[b]) == 0) {
+        uint64_t size = SIZE(s->tag[b]);
+        s->nfree++;
+        s->free += size;
+        if (size > s->largest) s->largest = size;
+      }
+    }
+
+    (*n)++;
+  }
+
+  fclose(f);
+  return ss;
+}
+
+/// @brief render the fragmentation map row of snapshot @a s at vertical offset @a y. The heap
+///        is scaled to the largest heap size @a max_heap of all snapshots.
+static void svg_map_row(FILE *f, const Snapshot *s, int y, uint64_t max_heap)
+{
+  double scale = (double)MAP_WIDTH / max_heap;
+  double used[MAP_WIDTH] = { 0 };
+  uint64_t addr = 0;
+
+  // accumulate the allocated bytes per pixel column
+  for (uint64_t b = 0; b < s->hdr.nblocks; b++) {
+    uint64_t size = SIZE(s->tag[b]);
+    if (STATUS(s->tag[b]) != 0) {
+      double from = addr * scale, to = (addr + size) * scale;
+      for (int x = (int)from; (x < MAP_WIDTH) && (x < to); x++) {
+        double l = x > from ? x : from, r = x + 1 < to ? x + 1 : to;
+        used[x] += r - l;
+      }
+    }
+    addr += size;
+  }
+
+  // emit one rectangle per run of identically shaded pixels
+  int width = (int)(s->hdr.heap_size * scale + 0.5);
+  int x = 0;
+  while (x < width) {
+    int shade = (int)(used[x] * 15 + 0.5), e = x + 1;
+    while ((e < width) && ((int)(used[e] * 15 + 0.5) == shade)) e++;
+
+    if (shade == 0) {
+      fprintf(f, "<rect x='%d' y='%d' width='%d' height='%d' fill='#8fd18f'/>\n",
+              MARGIN + x, y, e - x, ROW_HEIGHT);
+    } else {
+      int c = 0xe0 - shade * 0xe0 / 15;
+      fprintf(f, "<rect x='%d' y='%d' width='%d' height='%d' fill='#%02x%02x%02x'/>\n",
+              MARGIN + x, y, e - x, ROW_HEIGHT, 0xe0, c, c);
+    }
+    x = e;
+  }
+}
+
+/// @brief render a polyline of @a n values scaled to @a max at vertical offset @a y
+static void svg_line(FILE *f, const uint64_t *v, size_t n, uint64_t max, int y, const char *color)
+{
+  fprintf(f, "<polyline fill='none' stroke='%s' stroke-width='1.5' points='", color);
+  for (size_t i = 0; i < n; i++) {
+    double px = MARGIN + (n > 1 ? (double)i * MAP_WIDTH / (n - 1) : 0);
+    double py = y + CHART_HEIGHT - (max ? (double)v[i] * CHART_HEIGHT / max : 0);
+    fprintf(f, "%.1f,%.1f ", px, py);
+  }
+  fprintf(f, "'/>\n");
+}
+
+/// @brief render snapshots into an SVG file
+/// @param fn file name
+/// @param ss snapshots
+/// @param n number of snapshots
+static void render_svg(const char *fn, const Snapshot *ss, size_t n)
+{
+  FILE *f = fopen(fn, "w");
+  if (f == NULL) {
+    fprintf(stderr, "Cannot open '%s': %s.\n", fn, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  uint64_t max_heap = 0, max_free = 0;
+  uint64_t *largest = malloc(n * sizeof(uint64_t)), *free_bytes = malloc(n * sizeof(uint64_t));
+  for (size_t i = 0; i < n; i++) {
+    if (ss[i].hdr.heap_size > max_heap) max_heap = ss[i].hdr.heap_size;
+    if (ss[i].free > max_free) max_free = ss[i].free;
+    largest[i] = ss[i].largest;
+    free_bytes[i] = ss[i].free;
+  }
+
+  uint64_t hist[NBUCKETS] = { 0 }, max_hist = 0;
+  for (uint64_t b = 0; b < ss[n-1].hdr.nblocks; b++) {
+    if (STATUS(ss[n-1].tag[b]) == 0) {
+      int bucket = 63 - __builtin_clzll(SIZE(ss[n-1].tag[b]) | 1);
+      if (++hist[bucket] > max_hist) max_hist = hist[bucket];
+    }
+  }
+
+  int map_y = MARGIN;
+  int line_y = map_y + n * ROW_HEIGHT + MARGIN;
+  int hist_y = line_y + CHART_HEIGHT + MARGIN;
+  int height = hist_y + CHART_HEIGHT + MARGIN;
+
+  fprintf(f, "<svg xmlns='http://www.w3.org/2000/svg' width='%d' height='%d' "
+             "font-family='monospace' font-size='11'>\n", MAP_WIDTH + 2*MARGIN, height);
+  fprintf(f, "<rect width='100%%' height='100%%' fill='white'/>\n");
+
+  // fragmentation map
+  fprintf(f, "<text x='%d' y='%d'>fragmentation map (%lu snapshots, heap up to %lu bytes; "
+             "green: free, red: allocated)</text>\n", MARGIN, map_y - 8, n, max_heap);
+  for (size_t i = 0; i < n; i++) svg_map_row(f, &ss[i], map_y + i * ROW_HEIGHT, max_heap);
+
+  // largest free block & free bytes over time
+  fprintf(f, "<text x='%d' y='%d'>free bytes (blue, max %lu) and largest free block (red) "
+             "over time</text>\n", MARGIN, line_y - 8, max_free);
+  fprintf(f, "<rect x='%d' y='%d' width='%d' height='%d' fill='none' stroke='black'/>\n",
+          MARGIN, line_y, MAP_WIDTH, CHART_HEIGHT);
+  svg_line(f, free_bytes, n, max_free, line_y, "blue");
+  svg_line(f, largest, n, max_free, line_y, "red");
+
+  // free size histogram
+  fprintf(f, "<text x='%d' y='%d'>free block sizes of last snapshot (log2 buckets, max %lu "
+             "blocks)</text>\n", MARGIN, hist_y - 8, max_hist);
+  int bw = MAP_WIDTH / NBUCKETS;
+  for (int b = 5; b < NBUCKETS; b++) {
+    int h = max_hist ? hist[b] * CHART_HEIGHT / max_hist : 0;
+    int x = MARGIN + (b - 5) * bw;
+    fprintf(f, "<rect x='%d' y='%d' width='%d' height='%d' fill='#4a7fc1'/>\n",
+            x, hist_y + CHART_HEIGHT - h, bw - 2, h);
+    if (b % 4 == 1) {
+      fprintf(f, "<text x='%d' y='%d'>2^%d</text>\n", x, hist_y + CHART_HEIGHT + 12, b);
+    }
+  }
+
+  fprintf(f, "</svg>\n");
+  fclose(f);
+
+  free(largest);
+  free(free_bytes);
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <snapshot file> [svg file]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  size_t n;
+  Snapshot *ss = read_snapshots(argv[1], &n);
+  if (n == 0) {
+    fprintf(stderr, "No snapshots in '%s'.\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  printf("  %6s  %10s  %8s  %8s  %10s  %10s  %6s\n",
+         "id", "heap", "blocks", "free", "free bytes", "largest", "frag");
+  for (size_t i = 0; i < n; i++) {
+    const Snapshot *s = &ss[i];
+    double frag = s->free ? 100.0 * (1.0 - (double)s->largest / s->free) : 0.0;
+    printf("  %6u  %10lu  %8lu  %8lu  %10lu  %10lu  %5.1f%%\n",
+           s->hdr.id, s->hdr.heap_size, s->hdr.nblocks, s->nfree, s->free, s->largest, frag);
+  }
+
+  if (argc > 2) render_svg(argv[2], ss, n);
+
+  for (size_t i = 0; i < n; i++) free(ss[i].tag);
+  free(ss);
+
+  return EXIT_SUCCESS;
+}
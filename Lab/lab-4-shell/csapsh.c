@@ -38,10 +38,16 @@
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <signal.h>
+#include <spawn.h>
 #include <stdio.h>
+#include <stdio_ext.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <time.h>
@@ -50,8 +56,9 @@
 //--------------------------------------------------------------------------------------------------
 // Limits and constant definitions
 //
-#define MAXLINE    1024      ///< max. length of command line
-#define MAXJOBS      16      ///< max. number of jobs at any point in time
+#define MAXLINE    1024      ///< initial size of the input buffer
+#define MINJOBS      16      ///< initial capacity of the job list
+#define BWINDOW       4      ///< batch mode: up to BWINDOW*N started but unreported commands
 
 /// @name job states
 /// @{
@@ -82,11 +89,36 @@
 /// @brief Job struct containing information about a job
 typedef struct job_t {
   pid_t pid;                 ///< group ID of process group. GID must be PID of last process in pipe
-  int jid;                   ///< job ID [ 1, 2, ..., MAXJOBS ]
+  int jid;                   ///< job ID [ 1, 2, ... ]
   int state;                 ///< job state (UNDEF, BG, FG, or ST)
-  char cmdline[MAXLINE];     ///< command line
+  char cmdline[];            ///< command line
 } Job;
 
+/// @brief Job list. Jobs are found by job ID through an array indexed by the job ID and by PID
+///        through an open-addressing hash table (linear probing, backward-shift deletion), so
+///        lookups, additions, and deletions take constant time. A new job gets the job ID after the
+///        largest job ID in use; job IDs are thus recycled as soon as the jobs with the largest IDs
+///        terminate.
+typedef struct joblist_t {
+  Job **byjid;               ///< jobs indexed by job ID (byjid[0] is unused)
+  int jidcap;                ///< capacity of byjid
+  int maxjid;                ///< largest job ID in use, 0 if there are no jobs
+  Job **bypid;               ///< hash table PID -> job, NULL for empty slots
+  size_t pidcap;             ///< capacity of bypid (power of 2)
+  size_t njobs;              ///< number of jobs
+  Job *fg;                   ///< foreground job or NULL
+} JobList;
+
+/// @brief Batch command struct. The output of a batch command is collected in its own buffer and
+///        copied to stdout once the command and all commands before it have finished
+typedef struct bcmd_t {
+  pid_t pid;                 ///< PID of the command
+  int done;                  ///< 1 once the command has been reaped
+  int fd;                    ///< output buffer (memfd)
+  int status;                ///< wait status
+  char *cmdline;             ///< command line
+} BCmd;
+
 
 //--------------------------------------------------------------------------------------------------
 // Global variables
@@ -95,9 +127,11 @@ typedef struct job_t {
 char prompt[] = "csapsh> ";  ///< command line prompt (DO NOT CHANGE)
 int emit_prompt = 1;         ///< 1: emit prompt; 0: do not emit prompt
 int verbose = 0;             ///< 1: verbose mode; 0: normal mode
-int nextjid = 1;             ///< next job ID to allocate
+int batch = 0;               ///< >0: batch mode with up to batch commands in flight; 0: interactive
+int pipesize = 0;            ///< >0: buffer size of pipes between pipeline stages; 0: kernel default
 
-Job jobs[MAXJOBS];           ///< the job list
+JobList jobs;                ///< the job list
+int sigfd = -1;              ///< signalfd receiving the signals handled by the shell
 
 
 //--------------------------------------------------------------------------------------------------
@@ -108,10 +142,28 @@ void eval(char *cmdline);
 int builtin_cmd(char *argv[]);
 void do_bgfg(char *argv[]);
 void waitfg(pid_t pid);
+pid_t spawnjob(char ***argv, int **fd, size_t n);
 
 void sigchld_handler(int sig);
 void sigint_handler(int sig);
 void sigtstp_handler(int sig);
+void childstatus(pid_t pid, int status);
+
+void initsignals(void);
+void dispatch_signals(void);
+void waitsignal(void);
+
+
+//--------------------------------------------------------------------------------------------------
+// Batch mode
+//
+
+int batch_loop(int n);
+pid_t batch_start(char ***argv, char *outfile, int fd);
+int batch_childstatus(pid_t pid, int status);
+int batch_flush(void);
+void run_cmdstruct(char ***argv, char *outfile);
+int isbuiltin(char ***argv);
 
 
 //--------------------------------------------------------------------------------------------------
@@ -122,22 +174,22 @@ void sigtstp_handler(int sig);
 int parseline(const char *cmdline, char ****argv, char **outfile);
 
 // Job list manipulation functions
-void clearjob(Job *job);
-void initjobs(Job *jobs);
-int maxjid(Job *jobs);
-int addjob(Job *jobs, pid_t pid, int state, char *cmdline);
-int deletejob(Job *jobs, pid_t pid);
-pid_t fgpid(Job *jobs);
-Job *getjobpid(Job *jobs, pid_t pid);
-Job *getjobjid(Job *jobs, int jid);
+void initjobs(JobList *jobs);
+int maxjid(JobList *jobs);
+int addjob(JobList *jobs, pid_t pid, int state, char *cmdline);
+int deletejob(JobList *jobs, pid_t pid);
+void setjobstate(JobList *jobs, Job *job, int state);
+pid_t fgpid(JobList *jobs);
+Job *getjobpid(JobList *jobs, pid_t pid);
+Job *getjobjid(JobList *jobs, int jid);
 int pid2jid(pid_t pid);
-void listjobs(Job *jobs);
+void listjobs(JobList *jobs);
 
 // Helper functions
 void usage(const char *program);
 void unix_error(char *msg);
 void app_error(char *msg);
-void Signal(int signum, void (*handler)(int));
+void tunepipe(int fd[2]);
 void sigquit_handler(int sig);
 char* stripnewline(char *str);
 
@@ -149,14 +201,13 @@ char* stripnewline(char *str);
 int main(int argc, char **argv)
 {
   char c;
-  char cmdline[MAXLINE];
 
   // redirect stderr to stdout so that the driver will get all output 
   // on the pipe connected to stdout.
   dup2(STDOUT_FILENO, STDERR_FILENO);
 
   // parse command line
-  while ((c = getopt(argc, argv, "hvp")) != EOF) {
+  while ((c = getopt(argc, argv, "hvpb:s:")) != EOF) {
     switch (c) {
       case 'h': usage(argv[0]);   // print help message
                 break;
@@ -164,35 +215,84 @@ int main(int argc, char **argv)
                 break;
       case 'p': emit_prompt = 0;  // don't print a prompt
                 break;            // handy for automatic testing
+      case 'b': batch = atoi(optarg); // batch mode
+                if (batch < 1) usage(argv[0]);
+                break;
+      case 's': pipesize = atoi(optarg); // pipe buffer size
+                if (pipesize < 1) usage(argv[0]);
+                break;
       default:  usage(argv[0]);   // invalid option -> print help message
     }
   }
 
-  // install signal handlers
-  VERBOSE("Installing signal handlers...");
-  Signal(SIGINT,  sigint_handler);    // Ctrl-c
-  Signal(SIGTSTP, sigtstp_handler);   // Ctrl-z
-  Signal(SIGCHLD, sigchld_handler);   // Terminated or stopped child
-  Signal(SIGQUIT, sigquit_handler);   // Ctrl-Backslash (useful to exit shell)
+  // receive signals through a signalfd
+  VERBOSE("Setting up signal handling...");
+  initsignals();
 
   // initialize job list
-  initjobs(jobs);
+  initjobs(&jobs);
 
-  // execute read/eval loop
-  VERBOSE("Execute read/eval loop...");
-  while (1) {
-    if (emit_prompt) { printf("%s", prompt); fflush(stdout); }
+  // batch mode: run all commands from stdin concurrently
+  if (batch) {
+    VERBOSE("Execute batch loop with %d commands in flight...", batch);
+    return batch_loop(batch) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
 
-    if ((fgets(cmdline, MAXLINE, stdin) == NULL) && ferror(stdin)) {
-      app_error("fgets error");
+  // execute read/eval loop. The shell waits for input on stdin and for signals on sigfd at the
+  // same time; complete lines are evaluated as soon as they have been read.
+  VERBOSE("Execute read/eval loop...");
+  char *line = NULL;         // input buffer
+  size_t len = 0, cap = 0;   // number of bytes in and capacity of the input buffer
+  int eof = 0;
+
+  if (emit_prompt) { printf("%s", prompt); fflush(stdout); }
+  while (!eof) {
+    struct pollfd pfd[2] = {
+      { .fd = STDIN_FILENO, .events = POLLIN },
+      { .fd = sigfd,        .events = POLLIN },
+    };
+    if (poll(pfd, 2, -1) < 0) {
+      if (errno == EINTR) continue;
+      unix_error("poll");
     }
+    if (pfd[1].revents) dispatch_signals();
+    if (pfd[0].revents == 0) continue;
 
-    if (feof(stdin)) break;   // end of input (Ctrl-d)
-
-    eval(cmdline);
-
-    fflush(stdout);
+    // read input; keep room for an additional newline and the terminating null byte
+    if (cap - len < MAXLINE) {
+      cap = cap ? 2*cap : MAXLINE;
+      if ((line = realloc(line, cap)) == NULL) app_error("Out of memory.");
+    }
+    ssize_t res = read(STDIN_FILENO, &line[len], cap - len - 2);
+    if (res < 0) {
+      if ((errno == EINTR) || (errno == EAGAIN)) continue;
+      unix_error("read");
+    }
+    if (res == 0) {
+      // end of input (Ctrl-d); evaluate an unterminated last line
+      eof = 1;
+      if (len > 0) line[len++] = '\n';
+    }
+    len += res;
+
+    // evaluate all complete lines
+    size_t start = 0;
+    char *nl;
+    while ((nl = memchr(&line[start], '\n', len - start)) != NULL) {
+      size_t end = nl - line + 1;
+      char next = line[end];
+      line[end] = '\0';
+      eval(&line[start]);
+      line[end] = next;
+      start = end;
+
+      fflush(stdout);
+      if (emit_prompt && !eof) { printf("%s", prompt); fflush(stdout); }
+    }
+    memmove(line, &line[start], len - start);
+    len -= start;
   }
+  free(line);
 
   // that's all, folks!
   return EXIT_SUCCESS;
@@ -263,10 +363,7 @@ void eval(char *cmdline)
 
   //dump_cmdstruct(argv, outfile, mode);
   // TODO
-  sigset_t set;
-  sigemptyset(&set);
-  sigaddset(&set, SIGCHLD);
-  
+
   size_t n_pipe = 0;
   while (argv[++n_pipe] != NULL);
   
@@ -278,11 +375,12 @@ void eval(char *cmdline)
     fd[i][READ] = fd[i][WRITE] = -1;
     
     if (i != n_pipe-1) {
-      if (pipe(fd[i]) < 0) unix_error(NULL);
+      if (pipe2(fd[i], O_CLOEXEC) < 0) unix_error(NULL);
+      tunepipe(fd[i]);
     }
   }
   
-  fd[n_pipe-1][WRITE] = open(outfile, O_WRONLY|O_CREAT|S_IROTH, 0644);
+  fd[n_pipe-1][WRITE] = outfile ? open(outfile, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0644) : -1;
   
   if (fd[n_pipe-1][WRITE] < 0)  
     fd[n_pipe-1][WRITE] = STDOUT_FILENO;
@@ -297,20 +395,20 @@ void eval(char *cmdline)
   }
   
   if (n_pipe > 1 || !builtin_cmd(argv[0])) {
-    sigprocmask(SIG_BLOCK, &set, NULL);
-    if ((pid = fork()) < 0) unix_error(NULL);
-    else if (pid > 0) {
-      sigprocmask(SIG_UNBLOCK, &set, NULL);
-      if (addjob(jobs, pid, mode, cmdline)) {
-        if (mode == FG) {
-          waitfg(pid);
-        }
-        else if (mode == BG) {
-          printf("[%d] (%d) %s", pid2jid(pid), emit_prompt ? pid : -1, cmdline);
-        }
-      }
+    // children are reaped only when the shell processes the SIGCHLD event, so the job is always
+    // in the job list before that
+    if (!isbuiltin(argv)) {
+      // fast path: no built-in command has to run in a child, spawn the commands directly
+      pid = spawnjob(argv, fd, n_pipe);
     }
-    else {
+    else if ((pid = fork()) < 0) unix_error(NULL);
+    else if (pid == 0) {
+      // drop the parent's read-ahead of stdin; otherwise exit() in the child would seek the
+      // (shared) file offset of a regular input file back and the shell would re-read lines
+      __fpurge(stdin);
+      sigset_t mask;
+      sigemptyset(&mask);
+      sigprocmask(SIG_SETMASK, &mask, NULL);
       if (n_pipe == 1) {
         setpgid(0, 0);
         char *cmd = argv[0][0];
@@ -351,16 +449,85 @@ void eval(char *cmdline)
               unix_error(NULL);
             }
           }
+          exit(EXIT_SUCCESS);
         }
       }
     
       exit(EXIT_SUCCESS);
     }
+
+    // the commands hold their ends of the pipes now; close ours so that they see end-of-file
+    for (int j = 0; j < n_pipe; j++) {
+      if (fd[j][0] > 2) close(fd[j][0]);
+      if (fd[j][1] > 2) close(fd[j][1]);
+      fd[j][0] = fd[j][1] = -1;
+    }
+
+    if ((pid > 0) && addjob(&jobs, pid, mode, cmdline)) {
+      if (mode == FG) {
+        waitfg(pid);
+      }
+      else if (mode == BG) {
+        printf("[%d] (%d) %s", pid2jid(pid), emit_prompt ? pid : -1, cmdline);
+      }
+    }
   }
   for (int j = 0; j < n_pipe; j++) {
     if (fd[j][0] > 2) close(fd[j][0]);
     if (fd[j][1] > 2) close(fd[j][1]);
+    free(fd[j]);
   }
+  free(fd);
+  free_cmdstruct(argv);
+  free(argv);
+  free(outfile);
+}
+
+/// @brief Start the commands of a job with posix_spawn(). Unlike fork(), posix_spawn() does not
+///        copy the page tables of the shell (glibc implements it with clone(CLONE_VM|CLONE_VFORK)).
+///        The commands are started from the last to the first; the last command becomes the
+///        leader of the job's process group and its PID is the PID of the job. The commands are
+///        started with an empty signal mask.
+/// @param argv parsed command line
+/// @param fd descriptors of the job: command i reads from fd[i-1][READ] and writes to fd[i][WRITE]
+/// @param n number of commands
+/// @retval pid_t PID of the job
+/// @retval 0 if no command could be started
+pid_t spawnjob(char ***argv, int **fd, size_t n)
+{
+  posix_spawnattr_t attr;
+  sigset_t mask;
+  sigemptyset(&mask);
+  posix_spawnattr_init(&attr);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK);
+  posix_spawnattr_setsigmask(&attr, &mask);
+
+  pid_t pgid = 0;
+  for (size_t i = n; i-- > 0; ) {
+    // all other descriptors of the job are close-on-exec
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (i > 0) posix_spawn_file_actions_adddup2(&actions, fd[i-1][READ], STDIN_FILENO);
+    if (fd[i][WRITE] != STDOUT_FILENO) {
+      posix_spawn_file_actions_adddup2(&actions, fd[i][WRITE], STDOUT_FILENO);
+    }
+    posix_spawnattr_setpgroup(&attr, pgid);
+
+    pid_t pid;
+    int res = posix_spawnp(&pid, argv[i][0], &actions, &attr, argv[i], environ);
+    posix_spawn_file_actions_destroy(&actions);
+
+    if (res != 0) {
+      // same message as a forked child that fails to exec
+      printf("%s\n", strerror(res));
+      continue;
+    }
+    VERBOSE("    PID %d (%s): process group %d.", pid, argv[i][0], pgid ? pgid : pid);
+    if (pgid == 0) pgid = pid;
+  }
+
+  posix_spawnattr_destroy(&attr);
+  return pgid;
 }
 
 
@@ -381,7 +548,7 @@ int builtin_cmd(char *argv[])
     return 1;
   }
   else if (strcmp(cmd, "jobs") == 0) {
-    listjobs(jobs);
+    listjobs(&jobs);
     return 1;
   }
   return 0;
@@ -403,14 +570,14 @@ void do_bgfg(char *argv[])
   
   if (argv[1][0] == '%') {
     int jid = atoi(&argv[1][1]);
-    if ((job = getjobjid(jobs, jid)) == NULL) {
+    if ((job = getjobjid(&jobs, jid)) == NULL) {
       printf("(%d): No such job\n", jid);
       return;
     }
   }	 
   else {
     pid_t pid = atoi(argv[1]);
-    if ((job = getjobpid(jobs, pid)) == NULL) {
+    if ((job = getjobpid(&jobs, pid)) == NULL) {
       printf("(%d): No such process\n", pid);
       return;
     }
@@ -421,37 +588,369 @@ void do_bgfg(char *argv[])
     app_error("cannot kill process");
   
   if (strcmp(cmd, "bg") == 0) {
-    job->state = BG;
+    setjobstate(&jobs, job, BG);
     printf("[%d] (%d) %s", job->jid, emit_prompt ? job->pid : -1, job->cmdline);
   }
   else {
-    job->state = FG;
+    setjobstate(&jobs, job, FG);
     waitfg(pid);
   }
 }
 
-/// @brief Block until process pid is no longer the foreground process
+/// @brief Block until process pid is no longer the foreground process. Waits for signals on the
+///        signalfd and processes them until the job has terminated or stopped.
 /// @param pid PID of foreground process
 void waitfg(pid_t pid)
 {
-  // TODO
   VERBOSE("waitfg(%d)", pid);
-  while (pid == fgpid(jobs))
-    sleep(1);
-  return;
+
+  while (pid == fgpid(&jobs)) waitsignal();
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Batch mode
+//
+// In batch mode (-b N), csapsh reads command lines from stdin and keeps up to N of them running
+// at the same time. The output (stdout and stderr) of each command is collected in its own
+// in-memory buffer and copied to stdout in input order once the command and all commands before
+// it have finished, followed by a status line
+//   #<number> (<pid>) Exit <status> <cmdline>
+// or
+//   #<number> (<pid>) Signal <signal> <cmdline>
+// Command lines that contain a built-in command or run in the background ('&') are executed by
+// eval() after all earlier commands have finished.
+//
+// Commands that have finished keep their buffer until all commands before them have finished.
+// To bound the number of open buffers behind a slow command, no new command is started while
+// BWINDOW*N commands (at most half the descriptor limit) are started but not reported yet.
+//
+// Batch commands are not entered into the job list. The SIGCHLD handler passes their status on to
+// batch_childstatus().
+//
+
+static BCmd *bcmd = NULL;    ///< started but not yet reported batch commands, in input order
+static size_t bhead = 0;     ///< index of the oldest command in bcmd
+static size_t btail = 0;     ///< index past the youngest command in bcmd
+static size_t bcap = 0;      ///< capacity of bcmd
+static size_t bseq = 0;      ///< number of the command at bhead (1-based)
+static int brunning = 0;     ///< number of running batch commands
+
+/// @brief Batch loop. Runs the command lines read from stdin with up to @a n commands in flight.
+/// @param n maximum number of concurrently running commands
+/// @retval int number of commands that did not exit with status 0
+int batch_loop(int n)
+{
+  char *line = NULL;
+  size_t linecap = 0;
+  int failed = 0, eof = 0;
+
+  // each started command holds a descriptor for its output buffer until it is reported
+  size_t window = BWINDOW * (size_t)n;
+  struct rlimit rl;
+  if ((getrlimit(RLIMIT_NOFILE, &rl) == 0) && (rl.rlim_cur != RLIM_INFINITY) &&
+      (rl.rlim_cur / 2 < window))
+  {
+    window = rl.rlim_cur / 2 > 0 ? rl.rlim_cur / 2 : 1;
+  }
+  VERBOSE("Batch window: %lu commands", window);
+
+  while (!eof || (bhead < btail)) {
+    //
+    // start commands until n are running, the window is full, or a command line needs to be
+    // executed by eval()
+    //
+    char *barrier = NULL;
+    while (!eof && (barrier == NULL) && (brunning < n) && (btail - bhead < window)) {
+      ssize_t len = getline(&line, &linecap, stdin);
+      if (len < 0) {
+        if (ferror(stdin)) app_error("getline error");
+        eof = 1;
+        break;
+      }
+
+      // parseline expects a terminating newline
+      if (line[len-1] != '\n') {
+        if ((size_t)len + 2 > linecap) {
+          linecap = len + 2;
+          if ((line = realloc(line, linecap)) == NULL) app_error("Out of memory.");
+        }
+        line[len++] = '\n';
+        line[len] = '\0';
+      }
+
+      char ***argv = NULL;
+      char *outfile = NULL;
+      int mode = parseline(line, &argv, &outfile);
+      if ((mode == -1) || (argv == NULL)) continue;
+
+      if ((mode == BG) || isbuiltin(argv)) {
+        barrier = strdup(line);
+      } else {
+        if (btail == bcap) {
+          if (bhead > 0) {
+            memmove(bcmd, &bcmd[bhead], (btail-bhead)*sizeof(BCmd));
+            btail -= bhead;
+            bhead = 0;
+          } else {
+            bcap = bcap ? 2*bcap : 64;
+            if ((bcmd = realloc(bcmd, bcap*sizeof(BCmd))) == NULL) app_error("Out of memory.");
+          }
+        }
+
+        BCmd *c = &bcmd[btail];
+        c->fd = memfd_create("csapsh", MFD_CLOEXEC);
+        if (c->fd < 0) unix_error("memfd_create");
+        c->cmdline = strdup(line);
+        c->done = c->status = 0;
+        c->pid = batch_start(argv, outfile, c->fd);
+        if (c->pid > 0) {
+          brunning++;
+        } else {
+          c->done = 1;
+          c->status = W_EXITCODE(EXIT_FAILURE, 0);
+        }
+        btail++;
+      }
+
+      free_cmdstruct(argv);
+      free(argv);
+      free(outfile);
+    }
+
+    //
+    // wait for a command to finish and report all finished commands in input order
+    //
+    if (brunning > 0) waitsignal();
+    failed += batch_flush();
+
+    if (barrier != NULL) {
+      // finish all earlier commands, then let eval() handle the command line
+      while (brunning > 0) {
+        waitsignal();
+        failed += batch_flush();
+      }
+
+      eval(barrier);
+      fflush(stdout);
+      free(barrier);
+    }
+  }
+
+  free(line);
+  free(bcmd);
+
+  return failed;
+}
+
+/// @brief Start a batch command in a child process whose stdout and stderr are redirected to the
+///        output buffer @a fd. Single commands are started with posix_spawn(), pipelines in a
+///        forked child that waits for all of its commands.
+/// @param argv parsed command line
+/// @param outfile filename for output redirection or NULL
+/// @param fd output buffer
+/// @retval pid_t PID of the child
+/// @retval -1 if the command could not be started (the error message is in the output buffer)
+pid_t batch_start(char ***argv, char *outfile, int fd)
+{
+  if (argv[1] == NULL) {
+    posix_spawnattr_t attr;
+    sigset_t mask;
+    sigemptyset(&mask);
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+    posix_spawnattr_setsigmask(&attr, &mask);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fd, STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, fd, STDERR_FILENO);
+    if (outfile != NULL) {
+      posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, outfile,
+                                       O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    }
+
+    pid_t pid;
+    int res = posix_spawnp(&pid, argv[0][0], &actions, &attr, argv[0], environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+
+    if (res != 0) {
+      dprintf(fd, "%s\n", strerror(res));
+      return -1;
+    }
+    VERBOSE("Spawned batch command %s (PID %d)", argv[0][0], pid);
+    return pid;
+  }
+
+  pid_t pid = fork();
+  if (pid < 0) unix_error("fork");
+
+  if (pid == 0) {
+    __fpurge(stdin);   // see eval()
+    if ((dup2(fd, STDOUT_FILENO) < 0) || (dup2(fd, STDERR_FILENO) < 0)) unix_error(NULL);
+
+    sigset_t set;
+    sigemptyset(&set);
+    sigprocmask(SIG_SETMASK, &set, NULL);
+
+    run_cmdstruct(argv, outfile);
+  }
+
+  VERBOSE("Started batch command %s (PID %d)", argv[0][0], pid);
+  return pid;
+}
+
+/// @brief Record the status of a batch command.
+/// @param pid process ID
+/// @param status wait status
+/// @retval 1 if @a pid is a batch command
+/// @retval 0 otherwise
+int batch_childstatus(pid_t pid, int status)
+{
+  for (size_t i = bhead; i < btail; i++) {
+    if ((bcmd[i].pid == pid) && !bcmd[i].done) {
+      if (WIFSTOPPED(status)) return 1;   // batch commands are not job-controlled
+
+      bcmd[i].done = 1;
+      bcmd[i].status = status;
+      brunning--;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/// @brief Copy the output and print the status of finished commands at the head of bcmd.
+/// @retval int number of reported commands that did not exit with status 0
+int batch_flush(void)
+{
+  int failed = 0;
+  char buf[65536];
+
+  fflush(stdout);
+  while ((bhead < btail) && bcmd[bhead].done) {
+    BCmd *c = &bcmd[bhead];
+
+    ssize_t len;
+    off_t ofs = 0;
+    while ((len = pread(c->fd, buf, sizeof(buf), ofs)) > 0) {
+      for (ssize_t w, done = 0; done < len; done += w) {
+        if ((w = write(STDOUT_FILENO, buf + done, len - done)) < 0) unix_error("write");
+      }
+      ofs += len;
+    }
+    close(c->fd);
+
+    bseq++;
+    if (WIFSIGNALED(c->status)) {
+      printf("#%lu (%d) Signal %d %s", bseq, emit_prompt ? c->pid : -1, WTERMSIG(c->status),
+             c->cmdline);
+    } else {
+      printf("#%lu (%d) Exit %d %s", bseq, emit_prompt ? c->pid : -1, WEXITSTATUS(c->status),
+             c->cmdline);
+    }
+    fflush(stdout);
+    if (!WIFEXITED(c->status) || (WEXITSTATUS(c->status) != 0)) failed++;
+
+    free(c->cmdline);
+    bhead++;
+  }
+
+  return failed;
+}
+
+/// @brief Execute a parsed command line in the current (child) process. A single command is exec'd
+///        directly, a pipeline is started stage by stage and waited for. Exits with the status of
+///        the (last) command, or 128 + signal number if it was terminated by a signal. Does not
+///        return.
+/// @param argv parsed command line
+/// @param outfile filename for output redirection or NULL
+__attribute__((noreturn))
+void run_cmdstruct(char ***argv, char *outfile)
+{
+  if (outfile != NULL) {
+    int fd = open(outfile, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if ((fd < 0) || (dup2(fd, STDOUT_FILENO) < 0)) unix_error(outfile);
+    close(fd);
+  }
+
+  if (argv[1] == NULL) {
+    execvp(argv[0][0], argv[0]);
+    unix_error(NULL);
+  }
+
+  int in = -1;
+  pid_t last = 0;
+  for (size_t i = 0; argv[i] != NULL; i++) {
+    int fd[2] = { -1, -1 };
+    if (argv[i+1] != NULL) {
+      if (pipe(fd) < 0) unix_error("pipe");
+      tunepipe(fd);
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) unix_error("fork");
+
+    if (pid == 0) {
+      if (in >= 0) {
+        if (dup2(in, STDIN_FILENO) < 0) unix_error(NULL);
+        close(in);
+      }
+      if (fd[WRITE] >= 0) {
+        if (dup2(fd[WRITE], STDOUT_FILENO) < 0) unix_error(NULL);
+        close(fd[READ]);
+        close(fd[WRITE]);
+      }
+      execvp(argv[i][0], argv[i]);
+      unix_error(NULL);
+    }
+
+    if (in >= 0) close(in);
+    if (fd[WRITE] >= 0) close(fd[WRITE]);
+    in = fd[READ];
+    last = pid;
+  }
+
+  int status, result = EXIT_FAILURE;
+  pid_t pid;
+  while ((pid = wait(&status)) > 0) {
+    if (pid == last) result = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+  }
+  exit(result);
+}
+
+/// @brief Check whether any command of a parsed command line is a built-in command
+/// @param argv parsed command line
+/// @retval 1 if the command line contains a built-in command
+/// @retval 0 otherwise
+int isbuiltin(char ***argv)
+{
+  static const char *builtins[] = { "quit", "fg", "bg", "jobs", NULL };
+
+  for (size_t i = 0; argv[i] != NULL; i++) {
+    for (size_t b = 0; builtins[b] != NULL; b++) {
+      if (strcmp(argv[i][0], builtins[b]) == 0) return 1;
+    }
+  }
+
+  return 0;
 }
 
 
 //--------------------------------------------------------------------------------------------------
 // Signal handlers
 //
+// SIGCHLD, SIGINT, SIGTSTP, and SIGQUIT are blocked and delivered through a signalfd. The handlers
+// below are called by dispatch_signals() from the event loop, not in signal context, and may thus
+// freely modify the job list.
 
 /// @brief SIGCHLD handler. Sent to the shell whenever a child process terminates or stops because
 ///        it received a SIGSTOP or SIGTSTP signal. This handler reaps all zombies.
 /// @param sig signal (SIGCHLD)
 void sigchld_handler(int sig)
 {
-  // TODO
   VERBOSE("[SCH] SIGCHLD handler (signal: %d)", sig);
   
   int status;
@@ -459,30 +958,7 @@ void sigchld_handler(int sig)
   
   while ((pid = waitpid(WAIT_ANY, &status, WNOHANG|WUNTRACED)) > 0) {
     VERBOSE("[SCH]   Waitpid returned %d.", pid);
-    if (WIFEXITED(status)) {
-      VERBOSE("[SCH]   Process %d terminated normally.", pid);
-      VERBOSE("[SCH]   Job [%%%d] deleted.", pid2jid(pid));
-      deletejob(jobs, pid);
-    }
-    else if (WIFSIGNALED(status)) {
-      int signal = WTERMSIG(status);
-      VERBOSE("[SCH]   Process %d terminated by signal %d.", pid, signal);
-      VERBOSE("[SCH]   Job [%%%d] deleted.", pid2jid(pid));
-      deletejob(jobs, pid);
-    }
-    else if (WIFSTOPPED(status)) {
-      int signal = WSTOPSIG(status);
-      VERBOSE("[SCH]   Process %d stopped by signal %d.", pid, signal);
-      Job *job = getjobpid(jobs, pid);
-      if (job->state != ST) {
-        VERBOSE("[SCH] Forwarding signal to all members of job.");
-        job->state = ST; 
-      }
-    }
-    else {
-      VERBOSE("[SCH]   Process %d terminated abnormally.", pid);
-      exit(EXIT_FAILURE);
-    }
+    if (!batch_childstatus(pid, status)) childstatus(pid, status);
   }
   if (pid < 0 && errno != ECHILD) {
     unix_error(NULL);
@@ -490,16 +966,50 @@ void sigchld_handler(int sig)
 }
 
 
+/// @brief Update the job list after child @a pid changed its state to @a status (as returned by
+///        waitpid).
+/// @param pid process ID
+/// @param status wait status
+void childstatus(pid_t pid, int status)
+{
+  if (WIFEXITED(status)) {
+    VERBOSE("[SCH]   Process %d terminated normally.", pid);
+    VERBOSE("[SCH]   Job [%%%d] deleted.", pid2jid(pid));
+    deletejob(&jobs, pid);
+  }
+  else if (WIFSIGNALED(status)) {
+    int signal = WTERMSIG(status);
+    VERBOSE("[SCH]   Process %d terminated by signal %d.", pid, signal);
+    VERBOSE("[SCH]   Job [%%%d] deleted.", pid2jid(pid));
+    deletejob(&jobs, pid);
+  }
+  else if (WIFSTOPPED(status)) {
+    int signal = WSTOPSIG(status);
+    VERBOSE("[SCH]   Process %d stopped by signal %d.", pid, signal);
+    Job *job = getjobpid(&jobs, pid);
+    if ((job != NULL) && (job->state != ST)) {
+      VERBOSE("[SCH] Forwarding signal to all members of job.");
+      setjobstate(&jobs, job, ST);
+    }
+  }
+  else {
+    VERBOSE("[SCH]   Process %d terminated abnormally.", pid);
+    exit(EXIT_FAILURE);
+  }
+}
+
+
 /// @brief SIGINT handler. Sent to the shell whenever the user types Ctrl-c at the keyboard.a
 ///        Forward the signal to the foreground job.
 /// @param sig signal (SIGINT)
 void sigint_handler(int sig)
 {
-  // TODO
   VERBOSE("[SIH] SIGINT handler (signal: %d)", sig);
-  pid_t pid = fgpid(jobs);
-  if (!pid)
-    app_error("no foreground jobs");
+  pid_t pid = fgpid(&jobs);
+  if (!pid) {
+    VERBOSE("[SIH]   No foreground job, signal ignored.");
+    return;
+  }
   
   VERBOSE("[SIH]   PID of foreground process is %d.", pid);
   if (kill(-pid, SIGINT) == -1)
@@ -511,14 +1021,15 @@ void sigint_handler(int sig)
 /// @param sig signal (SIGTSTP)
 void sigtstp_handler(int sig)
 {
-  // TODO
   VERBOSE("[SSH] SIGTSTP handler (signal: %d)", sig);
-  pid_t pid = fgpid(jobs);
-  if (!pid)
-    app_error("no foreground jobs");
+  pid_t pid = fgpid(&jobs);
+  if (!pid) {
+    VERBOSE("[SSH]   No foreground job, signal ignored.");
+    return;
+  }
   
-  Job* job = getjobpid(jobs, pid);
-  job->state = ST;
+  Job* job = getjobpid(&jobs, pid);
+  if (job != NULL) setjobstate(&jobs, job, ST);
   
   VERBOSE("[SSH]   PID of foreground process is %d.", pid);
   if (kill(-pid, SIGTSTP) == -1)
@@ -751,36 +1262,46 @@ int parseline(const char *cmdline, char ****argv , char **outfile)
 // Job list manipulation functions
 //
 
-/// @brief Clear a job struct
-/// @param job job struct
-void clearjob(Job *job)
+/// @brief Home slot of PID @a pid in a hash table with capacity @a cap (power of 2)
+/// @param pid process ID
+/// @param cap capacity
+/// @retval size_t slot index
+static size_t pidhash(pid_t pid, size_t cap)
+{
+  return ((size_t)pid * 2654435761u) & (cap-1);
+}
+
+/// @brief Find the slot of PID @a pid in the hash table, or the empty slot where it belongs
+/// @param jobs job list
+/// @param pid process ID
+/// @retval size_t slot index
+static size_t pidslot(JobList *jobs, pid_t pid)
 {
-  job->pid = 0;
-  job->jid = 0;
-  job->state = UNDEF;
-  job->cmdline[0] = '\0';
+  size_t i = pidhash(pid, jobs->pidcap);
+  while ((jobs->bypid[i] != NULL) && (jobs->bypid[i]->pid != pid)) i = (i+1) & (jobs->pidcap-1);
+  return i;
 }
 
 /// @brief Initialize the job list
 /// @param jobs job list
-void initjobs(Job *jobs)
+void initjobs(JobList *jobs)
 {
-  for (int i = 0; i < MAXJOBS; i++)
-    clearjob(&jobs[i]);
+  jobs->jidcap = MINJOBS;
+  jobs->pidcap = 2*MINJOBS;
+  jobs->byjid = calloc(jobs->jidcap, sizeof(Job*));
+  jobs->bypid = calloc(jobs->pidcap, sizeof(Job*));
+  if ((jobs->byjid == NULL) || (jobs->bypid == NULL)) app_error("Out of memory.");
+  jobs->maxjid = 0;
+  jobs->njobs = 0;
+  jobs->fg = NULL;
 }
 
 /// @brief Returns largest allocated job ID
 /// @param jobs job list
 /// @retval int largest allocated job ID
-int maxjid(Job *jobs)
+int maxjid(JobList *jobs)
 {
-  int max = 0;
-
-  for (int i = 0; i < MAXJOBS; i++) {
-    if (jobs[i].jid > max) max = jobs[i].jid;
-  }
-
-  return max;
+  return jobs->maxjid;
 }
 
 /// @brief Add a job to the job list
@@ -790,25 +1311,48 @@ int maxjid(Job *jobs)
 /// @param cmdline command line
 /// @retval 1 on success
 /// @retval 0 on failure
-int addjob(Job *jobs, pid_t pid, int state, char *cmdline)
+int addjob(JobList *jobs, pid_t pid, int state, char *cmdline)
 {
   if (pid < 1) return 0;
 
-  for (int i = 0; i < MAXJOBS; i++) {
-    if (jobs[i].pid == 0) {
-      jobs[i].pid = pid;
-      jobs[i].state = state;
-      jobs[i].jid = nextjid++;
-      if (nextjid > MAXJOBS) nextjid = 1;
-      strncpy(jobs[i].cmdline, cmdline, MAXLINE-1);
-      jobs[i].cmdline[MAXLINE-1] = '\0';
-      VERBOSE("Added job [%d] %d %s", jobs[i].jid, jobs[i].pid, jobs[i].cmdline);
-      return 1;
+  size_t len = strlen(cmdline);
+  Job *job = malloc(sizeof(Job) + len + 1);
+  if (job == NULL) {
+    printf("Out of memory.\n");
+    return 0;
+  }
+  job->pid = pid;
+  job->state = state;
+  memcpy(job->cmdline, cmdline, len + 1);
+
+  // grow the tables: keep the hash table at most half full
+  if (jobs->maxjid + 1 >= jobs->jidcap) {
+    int cap = 2*jobs->jidcap;
+    Job **byjid = realloc(jobs->byjid, cap * sizeof(Job*));
+    if (byjid == NULL) app_error("Out of memory.");
+    for (int i = jobs->jidcap; i < cap; i++) byjid[i] = NULL;
+    jobs->byjid = byjid;
+    jobs->jidcap = cap;
+  }
+  if (2*(jobs->njobs + 1) > jobs->pidcap) {
+    Job **old = jobs->bypid;
+    size_t oldcap = jobs->pidcap;
+    jobs->pidcap *= 2;
+    if ((jobs->bypid = calloc(jobs->pidcap, sizeof(Job*))) == NULL) app_error("Out of memory.");
+    for (size_t i = 0; i < oldcap; i++) {
+      if (old[i] != NULL) jobs->bypid[pidslot(jobs, old[i]->pid)] = old[i];
     }
+    free(old);
   }
 
-  printf("Maximum number of jobs exceeded. Increase MAXJOBS and recompile shell.\n");
-  return 0;
+  job->jid = ++jobs->maxjid;
+  jobs->byjid[job->jid] = job;
+  jobs->bypid[pidslot(jobs, pid)] = job;
+  jobs->njobs++;
+  if (state == FG) jobs->fg = job;
+
+  VERBOSE("Added job [%d] %d %s", job->jid, job->pid, job->cmdline);
+  return 1;
 }
 
 /// @brief Delete job with PID @a pid from the job list
@@ -816,32 +1360,55 @@ int addjob(Job *jobs, pid_t pid, int state, char *cmdline)
 /// @param pid process ID
 /// @retval 1 on success
 /// @retval 0 on failure
-int deletejob(Job *jobs, pid_t pid)
+int deletejob(JobList *jobs, pid_t pid)
 {
   if (pid < 1) return 0;
 
-  for (int i = 0; i < MAXJOBS; i++) {
-    if (jobs[i].pid == pid) {
-      clearjob(&jobs[i]);
-      nextjid = maxjid(jobs)+1;
-      return 1;
+  size_t i = pidslot(jobs, pid);
+  Job *job = jobs->bypid[i];
+  if (job == NULL) return 0;
+
+  // backward-shift deletion: move later entries of the probe sequence into the hole unless their
+  // home slot lies cyclically in (hole, entry]
+  size_t mask = jobs->pidcap-1;
+  jobs->bypid[i] = NULL;
+  for (size_t j = (i+1) & mask; jobs->bypid[j] != NULL; j = (j+1) & mask) {
+    size_t h = pidhash(jobs->bypid[j]->pid, jobs->pidcap);
+    if (((j - h) & mask) >= ((j - i) & mask)) {
+      jobs->bypid[i] = jobs->bypid[j];
+      jobs->bypid[j] = NULL;
+      i = j;
     }
   }
 
-  return 0;
+  jobs->byjid[job->jid] = NULL;
+  while ((jobs->maxjid > 0) && (jobs->byjid[jobs->maxjid] == NULL)) jobs->maxjid--;
+  if (jobs->fg == job) jobs->fg = NULL;
+  jobs->njobs--;
+  free(job);
+
+  return 1;
 }
 
-/// @brief Return PID of current foreground job, 0 if no such job
+/// @brief Change the state of job @a job to @a state
 /// @param jobs job list
-/// @retval job_t* pointer to job struct
-/// @retval NULL if no such job exists
-pid_t fgpid(Job *jobs)
+/// @param job job
+/// @param state new job state
+void setjobstate(JobList *jobs, Job *job, int state)
 {
-  for (int i = 0; i < MAXJOBS; i++) {
-    if (jobs[i].state == FG) return jobs[i].pid;
-  }
+  if (jobs->fg == job) jobs->fg = NULL;
+  job->state = state;
+  if (state == FG) jobs->fg = job;
+}
 
-  return 0;
+/// @brief Return PID of current foreground job, 0 if no such job
+/// @param jobs job list
+/// @retval pid_t PID of the foreground job
+/// @retval 0 if there is no foreground job
+pid_t fgpid(JobList *jobs)
+{
+  Job *fg = jobs->fg;
+  return fg ? fg->pid : 0;
 }
 
 /// @brief Find a job by a process ID
@@ -849,15 +1416,11 @@ pid_t fgpid(Job *jobs)
 /// @param jid process ID
 /// @retval job_t* pointer to job struct
 /// @retval NULL if no such job exists
-Job* getjobpid(Job *jobs, pid_t pid)
+Job* getjobpid(JobList *jobs, pid_t pid)
 {
   if (pid < 1) return NULL;
 
-  for (int i = 0; i < MAXJOBS; i++) {
-    if (jobs[i].pid == pid) return &jobs[i];
-  }
-
-  return NULL;
+  return jobs->bypid[pidslot(jobs, pid)];
 }
 
 /// @brief Find a job by its job ID
@@ -865,15 +1428,11 @@ Job* getjobpid(Job *jobs, pid_t pid)
 /// @param jid job ID
 /// @retval job_t* pointer to job struct
 /// @retval NULL if no such job exists
-Job* getjobjid(Job *jobs, int jid)
+Job* getjobjid(JobList *jobs, int jid)
 {
   if (jid < 1) return NULL;
 
-  for (int i = 0; i < MAXJOBS; i++) {
-    if (jobs[i].jid == jid) return &jobs[i];
-  }
-
-  return NULL;
+  return jid <= jobs->maxjid ? jobs->byjid[jid] : NULL;
 }
 
 /// @brief Map process ID to job ID
@@ -882,31 +1441,27 @@ Job* getjobjid(Job *jobs, int jid)
 /// @retval 0 if no such job exists
 int pid2jid(pid_t pid)
 {
-  if (pid < 1) return 0;
-
-  for (int i=0; i<MAXJOBS; i++) {
-    if (jobs[i].pid == pid) return jobs[i].jid;
-  }
-
-  return 0;
+  Job *job = getjobpid(&jobs, pid);
+  return job ? job->jid : 0;
 }
 
 /// @brief Print job list
 /// @param jobs job list
-void listjobs(Job *jobs)
+void listjobs(JobList *jobs)
 {
-  for (int i = 0; i < MAXJOBS; i++) {
-    if (jobs[i].pid != 0) {
-      printf("[%d] (%d) ", jobs[i].jid, emit_prompt ? jobs[i].pid : -1);
+  for (int jid = 1; jid <= jobs->maxjid; jid++) {
+    Job *job = jobs->byjid[jid];
+    if (job != NULL) {
+      printf("[%d] (%d) ", job->jid, emit_prompt ? job->pid : -1);
 
-      switch (jobs[i].state) {
+      switch (job->state) {
         case BG: printf("Running ");    break;
         case FG: printf("Foreground "); break;
         case ST: printf("Stopped ");    break;
-        default: printf("listjobs: Internal error: job[%d].state=%d ", i, jobs[i].state);
+        default: printf("listjobs: Internal error: job[%d].state=%d ", jid, job->state);
       }
 
-      printf("%s", jobs[i].cmdline); // cmdline includes a newline
+      printf("%s", job->cmdline); // cmdline includes a newline
     }
   }
 }
@@ -920,10 +1475,12 @@ void listjobs(Job *jobs)
 __attribute__((noreturn))
 void usage(const char *program)
 {
-  printf("Usage: %s [-hvp]\n", basename(program));
+  printf("Usage: %s [-hvp] [-b N] [-s SIZE]\n", basename(program));
   printf("   -h   print this message\n");
   printf("   -v   print additional diagnostic information\n");
   printf("   -p   do not emit a command prompt\n");
+  printf("   -b N batch mode: run up to N commands from stdin at the same time\n");
+  printf("   -s SIZE  buffer size of the pipes between pipeline stages in bytes\n");
   exit(EXIT_FAILURE);
 }
 
@@ -946,19 +1503,63 @@ void app_error(char *msg)
   exit(EXIT_FAILURE);
 }
 
-/// @brief Wrapper for sigaction(). Installs the function @a handler as the signal handler
-///        for signal @a signum. Does not return on error.
-/// @param signum signal number to catch
-/// @param handler signal handler to invoke
-void Signal(int signum, void (*handler)(int))
+/// @brief Set the buffer size of pipe @a fd to @a pipesize bytes (if set). The kernel rounds the
+///        size up to a power of two pages; unprivileged users are limited to
+///        /proc/sys/fs/pipe-max-size. Failure is not fatal, the pipe keeps its default size.
+/// @param fd pipe
+void tunepipe(int fd[2])
 {
-  struct sigaction action;
+  if (pipesize == 0) return;
 
-  action.sa_handler = handler;
-  sigemptyset(&action.sa_mask); // block sigs of type being handled
-  action.sa_flags = SA_RESTART; // restart syscalls if possible
+  int size = fcntl(fd[WRITE], F_SETPIPE_SZ, pipesize);
+  if (size < 0) {
+    VERBOSE("    Cannot set pipe size to %d: %s", pipesize, strerror(errno));
+  } else {
+    VERBOSE("    Pipe size set to %d", size);
+  }
+}
 
-  if (sigaction(signum, &action, NULL) < 0) unix_error("Sigaction");
+/// @brief Block the signals handled by the shell and create a signalfd through which they are
+///        received instead. Does not return on error.
+void initsignals(void)
+{
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGCHLD);
+  sigaddset(&set, SIGINT);
+  sigaddset(&set, SIGTSTP);
+  sigaddset(&set, SIGQUIT);
+
+  if (sigprocmask(SIG_BLOCK, &set, NULL) < 0) unix_error("Sigprocmask");
+  if ((sigfd = signalfd(-1, &set, SFD_CLOEXEC|SFD_NONBLOCK)) < 0) unix_error("Signalfd");
+}
+
+/// @brief Read all pending signals from the signalfd and call their handlers
+void dispatch_signals(void)
+{
+  struct signalfd_siginfo si;
+  ssize_t n;
+
+  while ((n = read(sigfd, &si, sizeof(si))) == sizeof(si)) {
+    switch (si.ssi_signo) {
+      case SIGCHLD: sigchld_handler(SIGCHLD); break;
+      case SIGINT:  sigint_handler(SIGINT);   break;
+      case SIGTSTP: sigtstp_handler(SIGTSTP); break;
+      case SIGQUIT: sigquit_handler(SIGQUIT); break;
+    }
+  }
+  if ((n < 0) && (errno != EAGAIN) && (errno != EINTR)) unix_error("Signalfd read");
+}
+
+/// @brief Wait until at least one signal is pending and handle all pending signals
+void waitsignal(void)
+{
+  struct pollfd pfd = { .fd = sigfd, .events = POLLIN };
+
+  while (poll(&pfd, 1, -1) < 0) {
+    if (errno != EINTR) unix_error("Poll");
+  }
+  dispatch_signals();
 }
 
 /// @brief SIGQUIT handler. Terminates the shell.
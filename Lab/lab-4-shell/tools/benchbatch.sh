@@ -0,0 +1,61 @@
+#!/bin/bash
+#---------------------------------------------------------------------------------------------------
+# System Programming                       Shell Lab                                    Fall 2021
+#
+# script to benchmark the batch mode of csapsh
+#
+# Usage: bash benchbatch.sh [N...]
+#
+# Feeds a corpus of COUNT short-lived commands to 'csapsh -b N' for each N (default: 1 2 4 8 16)
+# and reports the wall time, the throughput, and the speedup over the first N. The output of each
+# run is checked against the output of the first run to make sure ordering is preserved.
+#
+# Environment variables:
+#   CSAPSH    shell binary (default: ../csapsh)
+#   COUNT     number of commands (default: 200)
+#   CMD       command; %d is replaced by the command's number (default: /bin/sh -c 'sleep 0.02; echo %d')
+#
+
+TOOLS=`dirname $0`
+CSAPSH=${CSAPSH:-$TOOLS/../csapsh}
+COUNT=${COUNT:-200}
+CMD=${CMD:-"/bin/sh -c 'sleep 0.02; echo %d'"}
+WIDTHS=${@:-1 2 4 8 16}
+
+if [[ ! -x $CSAPSH ]]; then
+  echo "Cannot execute '$CSAPSH'."
+  exit 1
+fi
+
+CORPUS=`mktemp`
+REF=`mktemp`
+OUT=`mktemp`
+trap "rm -f $CORPUS $REF $OUT" EXIT
+
+for ((i = 0; i < $COUNT; i++)); do
+  printf "$CMD\n" $i
+done > $CORPUS
+
+# print 'a op b' with three decimals
+calc() { awk "BEGIN { printf \"%.3f\", $1 }"; }
+
+TIMEFORMAT=%R
+printf "%6s  %10s  %12s  %8s  %s\n" "N" "wall [s]" "commands/s" "speedup" "output"
+BASE=
+for N in $WIDTHS; do
+  WALL=$( { time $CSAPSH -p -b $N < $CORPUS > $OUT; } 2>&1 )
+  BASE=${BASE:-$WALL}
+
+  if [[ ! -s $REF ]]; then
+    cp $OUT $REF
+    CHECK="reference"
+  elif cmp -s $OUT $REF; then
+    CHECK="identical"
+  else
+    CHECK="DIFFERENT"
+  fi
+
+  printf "%6d  %10.3f  %12.1f  %8.2f  %s\n" $N $WALL `calc "$COUNT / $WALL"` `calc "$BASE / $WALL"` $CHECK
+done
+
+exit 0
@@ -0,0 +1,63 @@
+#!/bin/bash
+#---------------------------------------------------------------------------------------------------
+# System Programming                       Shell Lab                                    Fall 2021
+#
+# script to benchmark the throughput of pipelines in csapsh
+#
+# Usage: bash benchpipe.sh [SIZE...]
+#
+# Creates a file of MB megabytes and copies it with 'cat FILE | cat > OUT' (and a three-stage
+# variant) through csapsh, once with the kernel's default pipe size and once with 'csapsh -s SIZE'
+# for each given pipe size in bytes (default: 262144 1048576). Reports the wall time and the
+# throughput and checks that the output matches the input. Unprivileged users cannot set pipe
+# sizes above /proc/sys/fs/pipe-max-size; such runs fall back to the default size.
+#
+# Environment variables:
+#   CSAPSH    shell binary (default: ../csapsh)
+#   MB        size of the input file in megabytes (default: 1024)
+#   RUNS      number of runs per configuration; the best run is reported (default: 3)
+#   TMPDIR    directory for the input and output files (default: /tmp)
+#
+
+TOOLS=`dirname $0`
+CSAPSH=${CSAPSH:-$TOOLS/../csapsh}
+MB=${MB:-1024}
+RUNS=${RUNS:-3}
+SIZES=${@:-262144 1048576}
+
+if [[ ! -x $CSAPSH ]]; then
+  echo "Cannot execute '$CSAPSH'."
+  exit 1
+fi
+
+IN=`mktemp`
+OUT=`mktemp`
+trap "rm -f $IN $OUT" EXIT
+
+head -c ${MB}M /dev/urandom > $IN
+
+# print 'a op b' with three decimals
+calc() { awk "BEGIN { printf \"%.3f\", $1 }"; }
+
+echo "input: $MB MB, pipe-max-size: `cat /proc/sys/fs/pipe-max-size` bytes"
+TIMEFORMAT=%R
+printf "%-24s  %10s  %10s  %10s  %s\n" "command" "pipe size" "wall [s]" "MB/s" "output"
+for CMD in "cat $IN | cat > $OUT" "cat $IN | cat | cat > $OUT"; do
+  NAME=`echo "$CMD" | sed "s|$IN|FILE|; s|$OUT|OUT|"`
+  for SIZE in default $SIZES; do
+    ARGS=-p
+    [[ $SIZE != default ]] && ARGS="-p -s $SIZE"
+
+    BEST=
+    for ((r = 0; r < $RUNS; r++)); do
+      rm -f $OUT
+      WALL=$( { time echo "$CMD" | $CSAPSH $ARGS > /dev/null; } 2>&1 )
+      [[ -z $BEST || `calc "$WALL < $BEST"` != 0.000 ]] && BEST=$WALL
+    done
+
+    cmp -s $IN $OUT && CHECK="identical" || CHECK="DIFFERENT"
+    printf "%-24s  %10s  %10.3f  %10.1f  %s\n" "$NAME" $SIZE $BEST `calc "$MB / $BEST"` $CHECK
+  done
+done
+
+exit 0
@@ -0,0 +1,48 @@
+#!/bin/bash
+#---------------------------------------------------------------------------------------------------
+# System Programming                       Shell Lab                                    Fall 2021
+#
+# script to benchmark how fast shells launch commands
+#
+# Usage: bash benchspawn.sh [shell...]
+#
+# Feeds COUNT foreground command lines to each given shell (default: ../csapsh) and reports the
+# wall time and the number of commands per second. Two loops are run: a single command
+# (/bin/true) and a two-stage pipeline (/bin/true | /bin/true). To compare two versions of the
+# shell, keep a copy of the old binary and pass both, e.g.,
+#   bash benchspawn.sh ./csapsh.old ../csapsh
+#
+# Environment variables:
+#   COUNT     number of command lines per loop (default: 2000)
+#
+
+TOOLS=`dirname $0`
+COUNT=${COUNT:-2000}
+SHELLS=${@:-$TOOLS/../csapsh}
+
+for SH in $SHELLS; do
+  if [[ ! -x $SH ]]; then
+    echo "Cannot execute '$SH'."
+    exit 1
+  fi
+done
+
+INPUT=`mktemp`
+trap "rm -f $INPUT" EXIT
+
+# print 'a op b' with three decimals
+calc() { awk "BEGIN { printf \"%.3f\", $1 }"; }
+
+TIMEFORMAT=%R
+printf "%-30s  %-20s  %10s  %12s\n" "shell" "command" "wall [s]" "commands/s"
+for CMD in "/bin/true" "/bin/true | /bin/true"; do
+  yes "$CMD" | head -n $COUNT > $INPUT
+
+  # feed the input through a pipe: older builds whose children exit() re-read a regular input file
+  for SH in $SHELLS; do
+    WALL=$( { time cat $INPUT | $SH -p > /dev/null; } 2>&1 )
+    printf "%-30s  %-20s  %10.3f  %12.1f\n" $SH "$CMD" $WALL `calc "$COUNT / $WALL"`
+  done
+done
+
+exit 0
@@ -0,0 +1,62 @@
+#!/bin/bash
+#---------------------------------------------------------------------------------------------------
+# System Programming                       Shell Lab                                    Fall 2021
+#
+# script to benchmark shells on the trace suite
+#
+# Usage: bash benchtrace.sh [shell...]
+#
+# Runs every trace in ../trace through the shell driver for each given shell (default: ../csapsh)
+# and reports the wall time per trace and the total wall time of the suite. To compare two
+# versions of the shell, keep a copy of the old binary and pass both, e.g.,
+#   bash benchtrace.sh ./csapsh.old ../csapsh
+#
+# The SLEEP commands in the traces put a lower bound on the wall time; the column 'sleep' shows
+# that bound, the column 'shell' the time on top of it that is spent in the shell and its jobs.
+#
+# Environment variables:
+#   DRIVER    shell driver (default: ./sdriver.pl)
+#   TRACES    traces to run (default: all traces in ../trace)
+#   ARGS      shell arguments (default: -p)
+#
+
+TOOLS=`dirname $0`
+DRIVER=${DRIVER:-./sdriver.pl}
+ARGS=${ARGS:--p}
+SHELLS=${@:-$TOOLS/../csapsh}
+
+for SH in $SHELLS; do
+  if [[ ! -x $SH ]]; then
+    echo "Cannot execute '$SH'."
+    exit 1
+  fi
+done
+SHELLS=`realpath $SHELLS`
+
+# the traces run the test programs with relative paths
+cd $TOOLS
+TRACES=${TRACES:-`ls ../trace/trace??.txt`}
+
+# print 'a op b' with three decimals
+calc() { awk "BEGIN { printf \"%.3f\", $1 }"; }
+
+TIMEFORMAT=%R
+for SH in $SHELLS; do
+  echo "$SH"
+  printf "  %-12s  %10s  %10s  %10s\n" "trace" "wall [s]" "sleep [s]" "shell [s]"
+
+  TOTAL=0
+  SLEEP=0
+  for T in $TRACES; do
+    WALL=$( { time $DRIVER -s $SH -a "$ARGS" -t $T > /dev/null 2>&1; } 2>&1 )
+    S=`awk '$1 == "SLEEP" { s += $2 } END { print s+0 }' $T`
+
+    printf "  %-12s  %10.3f  %10d  %10.3f\n" ${T##*/} $WALL $S `calc "$WALL - $S"`
+    TOTAL=`calc "$TOTAL + $WALL"`
+    SLEEP=$((SLEEP + S))
+  done
+
+  printf "  %-12s  %10.3f  %10d  %10.3f\n" "total" $TOTAL $SLEEP `calc "$TOTAL - $SLEEP"`
+done
+
+exit 0
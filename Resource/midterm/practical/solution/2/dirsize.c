@@ -2,10 +2,49 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
+#include <unistd.h>
+
+#define MAX_THREADS 256       // maximum number of threads (-j)
+
+// Traversal
+// =========
+// Every directory is a node. Nodes are processed by N threads (-j N, default 1) from a shared
+// stack; each thread sums the sizes of the files it sees in its own partial sum, the partial
+// sums are added up at the end.
+//
+// Subdirectories are opened with openat() relative to the descriptor of their parent, which
+// stays open until all subdirectories have been opened. To keep the number of open descriptors
+// bounded (even in trees deeper than RLIMIT_NOFILE), a parent's descriptor is closed right after
+// use whenever 'maxfd' or more descriptors are open. The remaining subdirectories of a closed
+// parent are then opened by walking down from the nearest open ancestor (or the root) with
+// openat(), so the traversal always completes. A node stays in memory as long as one of its
+// subdirectories does.
+
+// a directory
+struct dnode {
+  struct dnode *parent;       // parent directory, NULL for the root
+  char *name;                 // name relative to parent (path for the root)
+  int fd;                     // directory descriptor, -1 if not open
+  int pending;                // the node while it is read + subdirectories not opened yet
+  int refcnt;                 // the node until it has been read + subdirectory nodes
+  pthread_mutex_t lock;       // protects fd, pending, and refcnt
+};
+
+static pthread_mutex_t qlock = PTHREAD_MUTEX_INITIALIZER;  // protects the stack
+static pthread_cond_t  qcv   = PTHREAD_COND_INITIALIZER;   // signals new work or completion
+static struct dnode **stack;                              // directories to be processed
+static size_t nstack, scap;                               // size and capacity of stack
+static unsigned int active;                               // number of nodes being processed
+
+static int maxfd;                                         // descriptor budget
+static int nopen;                                         // number of open descriptors (atomic)
+static size_t total;                                      // sum of the partial sums
 
 // abort process with an optional error message
 void ABORT(char *msg)
@@ -30,33 +69,261 @@ struct dirent *getNext(DIR *dir)
   return next;
 }
 
-size_t dirsize(char *dn)
+// close the descriptor of node 'n' (lock held)
+static void closeFd(struct dnode *n)
+{
+  close(n->fd);
+  n->fd = -1;
+  __atomic_sub_fetch(&nopen, 1, __ATOMIC_RELAXED);
+}
+
+// return the descriptor of node 'n', (re)opening it if necessary (lock of 'n' held)
+static int nodeFd(struct dnode *n)
+{
+  if (n->fd >= 0) return n->fd;
+
+  struct dnode *p = n->parent;
+  int fd = -1;
+
+  if (p == NULL) {
+    fd = open(n->name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  } else {
+    pthread_mutex_lock(&p->lock);
+    if (p->fd >= 0) {
+      // usual case: the parent is open. Close it right away if we are over budget
+      fd = openat(p->fd, n->name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      if (__atomic_load_n(&nopen, __ATOMIC_RELAXED) >= maxfd) closeFd(p);
+      pthread_mutex_unlock(&p->lock);
+    } else {
+      pthread_mutex_unlock(&p->lock);
+
+      // the parent has been closed: walk up to the nearest open ancestor (or the root), take a
+      // private duplicate of its descriptor and walk back down with openat(). Only one lock is
+      // held at a time and at most two private descriptors are open.
+      struct dnode **chain = NULL;
+      size_t len = 0, cap = 0;
+      for (struct dnode *a = n; ; a = a->parent) {
+        if (len == cap) {
+          cap = cap ? 2*cap : 64;
+          if ((chain = realloc(chain, cap * sizeof(struct dnode*))) == NULL) ABORT("Out of memory.");
+        }
+        chain[len++] = a;
+
+        struct dnode *up = a->parent;
+        if (up == NULL) {
+          fd = open(a->name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+          len--;
+          break;
+        }
+        pthread_mutex_lock(&up->lock);
+        if (up->fd >= 0) fd = dup(up->fd);
+        pthread_mutex_unlock(&up->lock);
+        if (fd >= 0) break;
+      }
+
+      while ((fd >= 0) && (len > 0)) {
+        int next = openat(fd, chain[--len]->name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        close(fd);
+        fd = next;
+      }
+      free(chain);
+    }
+  }
+
+  if (fd < 0) ABORT(strerror(errno));
+  n->fd = fd;
+  __atomic_add_fetch(&nopen, 1, __ATOMIC_RELAXED);
+  return n->fd;
+}
+
+// one of the pending opens of node 'n' is done; close its descriptor if it is no longer needed
+static void unpend(struct dnode *n)
+{
+  pthread_mutex_lock(&n->lock);
+  if ((--n->pending == 0) && (n->fd >= 0)) closeFd(n);
+  pthread_mutex_unlock(&n->lock);
+}
+
+// drop a reference to node 'n'; frees the node (and, transitively, its ancestors) when unused
+static void release(struct dnode *n)
+{
+  while (n) {
+    pthread_mutex_lock(&n->lock);
+    int r = --n->refcnt;
+    pthread_mutex_unlock(&n->lock);
+    if (r > 0) return;
+
+    struct dnode *p = n->parent;
+    if (n->fd >= 0) closeFd(n);
+    pthread_mutex_destroy(&n->lock);
+    free(n->name);
+    free(n);
+    n = p;
+  }
+}
+
+// create a node for directory 'name' in 'parent' and push it onto the stack
+static void push(struct dnode *parent, char *name)
 {
+  struct dnode *n = calloc(1, sizeof(struct dnode));
+  if (n == NULL) ABORT("Out of memory.");
+  n->parent = parent;
+  n->name = name;
+  n->fd = -1;
+  n->pending = n->refcnt = 1;
+  pthread_mutex_init(&n->lock, NULL);
+
+  if (parent) {
+    pthread_mutex_lock(&parent->lock);
+    parent->pending++;
+    parent->refcnt++;
+    pthread_mutex_unlock(&parent->lock);
+  }
+
+  pthread_mutex_lock(&qlock);
+  if (nstack == scap) {
+    scap = scap ? 2*scap : 256;
+    if ((stack = realloc(stack, scap * sizeof(struct dnode*))) == NULL) ABORT("Out of memory.");
+  }
+  stack[nstack++] = n;
+  pthread_cond_signal(&qcv);
+  pthread_mutex_unlock(&qlock);
+}
+
+// sum the sizes of the files in directory 'n' and push its subdirectories
+static size_t processDir(struct dnode *n)
+{
+  //
+  // open the directory relative to its parent; the parent's descriptor is not needed for it anymore
+  //
+  pthread_mutex_lock(&n->lock);
+  int dd = dup(nodeFd(n));
+  pthread_mutex_unlock(&n->lock);
+  if (n->parent) unpend(n->parent);
+
+  //
+  // read it through a private duplicate so that evicting n->fd does not affect us
+  //
+  DIR *d = (dd >= 0) ? fdopendir(dd) : NULL;
+  if (d == NULL) ABORT(strerror(errno));
+  __atomic_add_fetch(&nopen, 1, __ATOMIC_RELAXED);
+
   size_t size = 0;
+  struct dirent *entry;
+  struct stat sb;
+  while ((entry = getNext(d)) != NULL) {
+    // directories are recognized by d_type; regular files and unknown types are stat'ed
+    int isdir = entry->d_type == DT_DIR;
+    if ((entry->d_type == DT_REG) || (entry->d_type == DT_UNKNOWN)) {
+      if (fstatat(dd, entry->d_name, &sb, AT_SYMLINK_NOFOLLOW) != 0) ABORT(strerror(errno));
+      if (S_ISREG(sb.st_mode)) size += sb.st_size;
+      isdir = S_ISDIR(sb.st_mode);
+    }
+
+    if (isdir) {
+      char *name = strdup(entry->d_name);
+      if (name == NULL) ABORT("Out of memory.");
+      push(n, name);
+    }
+  }
+
+  closedir(d);
+  __atomic_sub_fetch(&nopen, 1, __ATOMIC_RELAXED);
+
+  unpend(n);
+  release(n);
+  return size;
+}
+
+// thread: process directories until the stack is empty and no directory is being processed
+static void* worker(void *arg)
+{
+  (void)arg;
+  size_t sum = 0;
 
+  pthread_mutex_lock(&qlock);
+  while (1) {
+    while ((nstack == 0) && (active > 0)) pthread_cond_wait(&qcv, &qlock);
+    if (nstack == 0) break;
+
+    struct dnode *n = stack[--nstack];
+    active++;
+    pthread_mutex_unlock(&qlock);
+
+    sum += processDir(n);
+
+    pthread_mutex_lock(&qlock);
+    if ((--active == 0) && (nstack == 0)) pthread_cond_broadcast(&qcv);
+  }
+  total += sum;
+  pthread_mutex_unlock(&qlock);
+
+  return NULL;
+}
+
+size_t dirsize(char *dn, unsigned int nthreads)
+{
   //
-  // TODO
+  // use at most half of the available descriptors for directories. Outside this budget, stdio
+  // needs 3 descriptors and each thread up to 4: its directory stream, two private descriptors
+  // while walking down from an open ancestor, and one node descriptor opened over the budget.
+  // Reduce the number of threads if the limit is too low for all of them.
   //
+  struct rlimit rl;
+  maxfd = 8;
+  if ((getrlimit(RLIMIT_NOFILE, &rl) == 0) && (rl.rlim_cur != RLIM_INFINITY)) {
+    long avail = (long)rl.rlim_cur - 3;
+    if (avail < 5) ABORT("Not enough file descriptors.");
+    if (avail - 4*(long)nthreads < 1) nthreads = (avail - 1) / 4;
+    maxfd = avail - 4*nthreads;
+    if (maxfd > (long)rl.rlim_cur / 2) maxfd = rl.rlim_cur / 2;
+  }
+
+  char *name = strdup(dn);
+  if (name == NULL) ABORT("Out of memory.");
+  push(NULL, name);
+
+  //
+  // the main thread is one of the workers
+  //
+  pthread_t thread[MAX_THREADS];
+  unsigned int started = 0;
+  while ((started < nthreads - 1) && (pthread_create(&thread[started], NULL, worker, NULL) == 0)) started++;
+  worker(NULL);
+  for (unsigned int i = 0; i < started; i++) pthread_join(thread[i], NULL);
+
+  free(stack);
 
   //
   // return size
   //
-  return size;
+  return total;
 }
 
 
 int main(int argc, char *argv[])
 {
   //
-  // use directory provided on command line or '.' if none given
+  // dirsize [-j N] [dir]: use directory provided on command line or '.' if none given
   //
-  char *dir = argc > 1 ? argv[1] : ".";
+  unsigned int nthreads = 1;
+  int a = 1;
+  if ((argc > 2) && (strcmp(argv[1], "-j") == 0)) {
+    int n = atoi(argv[2]);
+    if ((n < 1) || (n > MAX_THREADS)) {
+      printf("Invalid number of threads '%s'.\n", argv[2]);
+      return 1;
+    }
+    nthreads = n;
+    a = 3;
+  }
+  char *dir = argc > a ? argv[a] : ".";
 
   //
   // let the magic work...
   //
   printf("Computing size of '%s'\n", dir); fflush(stdout);
-  size_t s = dirsize(dir);
+  size_t s = dirsize(dir, nthreads);
   printf("  size: %lu bytes\n", s);
 
   //